@@ -0,0 +1,119 @@
+/* Declarative board description
+ *
+ * A board is a table of pins (port, pin, mode, alternate function, pull,
+ * speed, output type) plus the peripheral clocks it needs. board_compile()
+ * folds the table at compile time into one mask/value pair per GPIO
+ * register per port, and board_apply() writes each register once. That
+ * replaces a chain of per-pin read-modify-writes (each of which also
+ * re-enabled the port clock).
+ *
+ *   constexpr board_pin pins[] = {BOARD_SERIAL_PINS, {BOARD_PORT_A, 8, OUTPUT, 0, PULL_OFF, LOW_SPD, PUSH_PULL}};
+ *   constexpr board_config board = board_compile(pins, 0, 0);
+ *   board_apply(&board);
+ */
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include "ee14lib.h"
+#include <stddef.h>
+
+#define BOARD_PORT_A 0
+#define BOARD_PORT_B 1
+#define BOARD_PORT_C 2
+#define BOARD_PORT_H 3
+#define BOARD_PORTS 4
+
+typedef struct {
+    uint8_t port;  // BOARD_PORT_x
+    uint8_t pin;   // 0-15
+    uint8_t mode;  // INPUT, OUTPUT, ALTERNATE_FUNCTION or ANALOG
+    uint8_t af;    // Alternate function 0-15, ignored unless mode is ALTERNATE_FUNCTION
+    uint8_t pull;  // PULL_OFF, PULL_UP or PULL_DOWN
+    uint8_t speed; // LOW_SPD ... V_HI_SPD
+    uint8_t otype; // PUSH_PULL or OPEN_DRAIN
+} board_pin;
+
+// Bits to change (mask) and what to change them to (value) for each register
+typedef struct {
+    uint32_t moder_mask, moder;
+    uint32_t otyper_mask, otyper;
+    uint32_t ospeedr_mask, ospeedr;
+    uint32_t pupdr_mask, pupdr;
+    uint32_t afr_mask[2], afr[2];
+} board_port;
+
+typedef struct {
+    board_port ports[BOARD_PORTS];
+    uint32_t ahb2enr;  // GPIO port clocks, derived from the pins
+    uint32_t apb1enr1; // Peripheral clocks, as given
+    uint32_t apb2enr;
+} board_config;
+
+// USART2 to the ST-Link virtual COM port (PA2/PA3) and USART1 to the
+// fingerprint sensor (PA9/PA10): AF7, pull-up, very high speed, push-pull.
+#define BOARD_SERIAL_PINS \
+    {BOARD_PORT_A, 2, ALTERNATE_FUNCTION, 7, PULL_UP, V_HI_SPD, PUSH_PULL},  /* USART2_TX */ \
+    {BOARD_PORT_A, 3, ALTERNATE_FUNCTION, 7, PULL_UP, V_HI_SPD, PUSH_PULL},  /* USART2_RX */ \
+    {BOARD_PORT_A, 9, ALTERNATE_FUNCTION, 7, PULL_UP, V_HI_SPD, PUSH_PULL},  /* USART1_TX (D1) */ \
+    {BOARD_PORT_A, 10, ALTERNATE_FUNCTION, 7, PULL_UP, V_HI_SPD, PUSH_PULL}  /* USART1_RX (D0) */
+
+#define BOARD_SERIAL_APB1ENR1 RCC_APB1ENR1_USART2EN
+#define BOARD_SERIAL_APB2ENR RCC_APB2ENR_USART1EN
+
+// Fold a pin table into per-register mask/value pairs. Evaluated by the
+// compiler when the result is constexpr.
+template <size_t N>
+constexpr board_config board_compile(const board_pin (&pins)[N], uint32_t apb1enr1, uint32_t apb2enr)
+{
+    board_config cfg = {};
+    const uint32_t port_clock[BOARD_PORTS] = {
+        RCC_AHB2ENR_GPIOAEN, RCC_AHB2ENR_GPIOBEN, RCC_AHB2ENR_GPIOCEN, RCC_AHB2ENR_GPIOHEN
+    };
+
+    for (size_t i = 0; i < N; i++) {
+        const board_pin &p = pins[i];
+        board_port &port = cfg.ports[p.port];
+        uint32_t two = 2 * p.pin;
+
+        port.moder_mask |= 0x3UL << two;
+        port.moder |= (uint32_t)p.mode << two;
+        port.otyper_mask |= 0x1UL << p.pin;
+        port.otyper |= (uint32_t)p.otype << p.pin;
+        port.ospeedr_mask |= 0x3UL << two;
+        port.ospeedr |= (uint32_t)p.speed << two;
+        port.pupdr_mask |= 0x3UL << two;
+        port.pupdr |= (uint32_t)p.pull << two;
+        if (p.mode == ALTERNATE_FUNCTION) {
+            int idx = p.pin >= 8;
+            uint32_t four = 4 * (p.pin - 8 * idx);
+            port.afr_mask[idx] |= 0xFUL << four;
+            port.afr[idx] |= (uint32_t)p.af << four;
+        }
+        cfg.ahb2enr |= port_clock[p.port];
+    }
+    cfg.apb1enr1 = apb1enr1;
+    cfg.apb2enr = apb2enr;
+    return cfg;
+}
+
+// True if no pin appears twice and every field is in range; use in a
+// static_assert next to the table.
+template <size_t N>
+constexpr bool board_pins_valid(const board_pin (&pins)[N])
+{
+    for (size_t i = 0; i < N; i++) {
+        const board_pin &p = pins[i];
+        if (p.port >= BOARD_PORTS || p.pin > 15 || p.mode > 3 || p.af > 15 ||
+            p.pull > PULL_DOWN || p.speed > 3 || p.otype > 1)
+            return false;
+        for (size_t j = i + 1; j < N; j++)
+            if (pins[j].port == p.port && pins[j].pin == p.pin) return false;
+    }
+    return true;
+}
+
+void board_apply(const board_config *cfg);
+void board_init();
+
+#endif
@@ -0,0 +1,42 @@
+/* Checksums and CRCs
+ *
+ * checksum_sum16() is the ZFM sensor packet checksum: the 16-bit sum of the
+ * packet type, length and payload bytes. It is computed a word at a time,
+ * with the Cortex-M4 USADA8 instruction (sum of four bytes in one cycle)
+ * where the DSP extension is available and with a portable SIMD-within-a-
+ * register version otherwise. checksum_sum16_bytewise() is the reference.
+ *
+ * The CRCs use the STM32 CRC unit when built for the target and a
+ * table-driven version elsewhere; both give the same values:
+ *   checksum_crc16_ccitt()  CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+ *   checksum_crc32()        CRC-32 as in zlib/Python's zlib.crc32
+ *
+ * This file and checksum.cpp don't need the device header off target, so
+ * they also build on a host (see test/test_checksum).
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+
+#if defined(__ARM_FEATURE_SIMD32)
+#define CHECKSUM_HAVE_SIMD 1
+#endif
+#if defined(__arm__) && !defined(CHECKSUM_SOFT_CRC)
+#define CHECKSUM_HAVE_HW_CRC 1
+#endif
+
+uint16_t checksum_sum16(uint16_t sum, const uint8_t *data, uint32_t len);
+uint16_t checksum_sum16_bytewise(uint16_t sum, const uint8_t *data, uint32_t len);
+uint16_t checksum_sum16_swar(uint16_t sum, const uint8_t *data, uint32_t len);
+#ifdef CHECKSUM_HAVE_SIMD
+uint16_t checksum_sum16_simd(uint16_t sum, const uint8_t *data, uint32_t len);
+#endif
+
+uint16_t checksum_crc16_ccitt(const uint8_t *data, uint32_t len);
+uint32_t checksum_crc32(const uint8_t *data, uint32_t len);
+uint16_t checksum_crc16_ccitt_soft(const uint8_t *data, uint32_t len);
+uint32_t checksum_crc32_soft(const uint8_t *data, uint32_t len);
+
+#endif
@@ -0,0 +1,41 @@
+/* Flash-backed configuration and enrollment store
+ *
+ * A small append-only key/value log kept in the last two flash pages.
+ * Each update appends a CRC-protected record; when the active page fills,
+ * the newest value of every key is compacted into the other page, which
+ * then takes over. Boot only has to scan one page to rebuild the index.
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include "ee14lib.h"
+
+// The two pages at the very end of flash. The firmware image must stay below
+// FLASH_PAGE_ADDR(CONFIG_STORE_FIRST_PAGE).
+#define CONFIG_STORE_FIRST_PAGE (FLASH_PAGE_COUNT - 2)
+#define CONFIG_STORE_PAGES 2
+
+// Keys are small integers below CONFIG_MAX_KEYS; values are at most
+// CONFIG_MAX_VALUE bytes.
+#define CONFIG_MAX_KEYS 16
+#define CONFIG_MAX_VALUE 32
+
+#define CONFIG_KEY_DUTY_CLOSED 1     // uint32, servo duty (0-1023) with lid closed
+#define CONFIG_KEY_DUTY_OPEN 2       // uint32, servo duty (0-1023) with lid open
+#define CONFIG_KEY_SENSOR_BAUD 3     // uint32, USART1 baud rate
+#define CONFIG_KEY_SENSOR_PASSWORD 4 // uint32, VERIFYPASSWORD argument
+#define CONFIG_KEY_ENROLLED 5        // Bitmap of occupied sensor pages, bit n = page n
+#define CONFIG_KEY_SCAN_MODE 6       // uint32, nonzero for continuous scanning (scan.h)
+
+// Room for one bit per sensor page (the sensor holds 200 templates)
+#define CONFIG_ENROLLED_PAGES 200
+#define CONFIG_ENROLLED_BYTES ((CONFIG_ENROLLED_PAGES + 7) / 8)
+
+EE14Lib_Err config_store_init();
+int config_get(uint8_t key, void *value, int max_len);
+EE14Lib_Err config_set(uint8_t key, const void *value, uint8_t len);
+uint32_t config_get_u32(uint8_t key, uint32_t default_value);
+EE14Lib_Err config_set_u32(uint8_t key, uint32_t value);
+
+#endif
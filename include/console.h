@@ -0,0 +1,33 @@
+/* Commands typed on the serial monitor
+ *
+ * Lines typed into the serial monitor (USART2) are buffered by its receive
+ * interrupt while the firmware is busy scanning; console_poll() runs the
+ * lines that have arrived. A line is a command name and its arguments,
+ * separated by spaces, e.g. "set duty_open 80". The commands themselves come
+ * from the caller's table. Typed characters aren't echoed back, so open the
+ * monitor with "pio device monitor -b 9600 --echo".
+ *
+ * It is how the keys in the config store (config_store.h) get written:
+ * without it the settings could only ever hold their defaults.
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include "ee14lib.h"
+
+#define CONSOLE_MAX_LINE 48
+#define CONSOLE_MAX_ARGS 4 // Including the command name
+
+typedef struct {
+    const char *name;
+    uint8_t args;                         // Arguments after the name
+    void (*run)(char **argv);             // argv[0] is the name
+    const char *usage;                    // Shown by "help" and on a bad line
+} console_command;
+
+void console_init();
+void console_poll(const console_command *commands, int count);
+bool console_parse_u32(const char *text, uint32_t *value);
+
+#endif
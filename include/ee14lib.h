@@ -16,6 +16,7 @@ typedef int EE14Lib_Err;
 #define EE14Lib_Err_INEXPLICABLE_FAILURE -1
 #define EE14Lib_Err_NOT_IMPLEMENTED -2
 #define EE14Lib_ERR_INVALID_CONFIG -3
+#define EE14Lib_ERR_FLASH -4
 
 // GPIO modes
 #define INPUT 0b00
@@ -48,22 +49,55 @@ EE14Lib_Err gpio_config_alternate_function(EE14Lib_Pin pin, unsigned int functio
 void gpio_write(EE14Lib_Pin pin, bool value);
 bool gpio_read(EE14Lib_Pin pin);
 
-// Initialize the serial port
+// Initialize the serial ports: pins, clocks, then serial_start()
 void host_serial_init();
+// Start USART2 (9600) and USART1 (57600) once their pins and clocks are set up
+void serial_start();
 
 // Very basic function: send a character string to the UART, one byte at a time.
 // Spin wait after each byte until the UART is ready for the next byte.
 void serial_write(USART_TypeDef *USARTx, const char *buffer, int len);
+// Send an unsigned integer in decimal
+void serial_write_uint(USART_TypeDef *USARTx, uint32_t value);
 
+// Define EE14LIB_NO_FLOAT to scale duty cycles with integer math only
 EE14Lib_Err timer_config_pwm(TIM_TypeDef* const timer, const unsigned int freq_hz);
 EE14Lib_Err timer_config_channel_pwm(TIM_TypeDef* const timer, const EE14Lib_Pin pin, const unsigned int duty);
 void timer_set_pwm_duty(TIM_TypeDef *timer, EE14Lib_Pin pin, unsigned int duty_0_to_1023);
 
+// Free-running CPU cycle counter (DWT->CYCCNT), wraps every ~53 s at 80 MHz
+void cycle_counter_init();
+uint32_t cycle_counter_read();
+
 // Spin wait until we have a byte.
 char serial_read(USART_TypeDef *USARTx);
+// Wait up to timeout_us for a byte; returns 0-255, or -1 on timeout.
+int serial_read_timeout(USART_TypeDef *USARTx, uint32_t timeout_us);
+// Discard any pending received bytes; returns how many were dropped.
+int serial_flush_rx(USART_TypeDef *USARTx);
+// Buffer received bytes from an RXNE interrupt instead of the 1-byte register,
+// in a ring that holds SERIAL_RX_RING_SIZE - 1 bytes
+#define SERIAL_RX_RING_SIZE 256
+void serial_rx_interrupt_enable(USART_TypeDef *USARTx);
+// Received bytes lost since the interrupt was enabled (ring full or overrun)
+uint32_t serial_rx_dropped(USART_TypeDef *USARTx);
 void USART_Delay(uint32_t us);
 
 void set_gpio_alt_func (GPIO_TypeDef *gpio,unsigned int pin,unsigned int func);
+// Change the baud rate of an already-initialized USART; refuses 0 or a rate
+// above SystemCoreClock / 16
+EE14Lib_Err serial_set_baud(USART_TypeDef *USARTx, int baud);
+
+// Flash is 128 pages of 2 KB starting at FLASH_BASE (0x08000000)
+#define FLASH_PAGE_SIZE 2048
+#define FLASH_PAGE_COUNT 128
+#define FLASH_PAGE_ADDR(page) (FLASH_BASE + (uint32_t)(page) * FLASH_PAGE_SIZE)
+
+EE14Lib_Err flash_erase_page(unsigned int page);
+EE14Lib_Err flash_program_dword(uintptr_t address, uint64_t value);
+// Fails with EE14Lib_ERR_FLASH on an uncorrectable ECC error, e.g. a double
+// word whose programming was cut short
+EE14Lib_Err flash_read_dword(uintptr_t address, uint64_t *value);
 
 
 
@@ -0,0 +1,146 @@
+/* Fingerprint sensor (ZFM-20 / Adafruit 4690) packet protocol and link layer.
+ *
+ * Every command goes out as a command packet and the sensor answers with one
+ * ACK packet. The link layer below frames and validates those replies, hunts
+ * for the 0xEF01 header after line noise, and retries idempotent commands
+ * when a reply is missing, late or corrupted.
+ */
+
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include "ee14lib.h"
+#include <stddef.h>
+
+// Packet and Command constants
+#define FINGERPRINT_START_CODE_H 0xEF
+#define FINGERPRINT_START_CODE_L 0x01
+#define FINGERPRINT_ADDR 0xFFFFFFFF
+#define FINGERPRINT_COMMANDPACKET 0x01
+#define FINGERPRINT_ACKPACKET 0x07
+#define FINGERPRINT_GETIMAGE 0x01
+#define FINGERPRINT_IMAGE2TZ 0x02
+#define FINGERPRINT_MATCH 0x03
+#define FINGERPRINT_SEARCH 0x04   // Args: BufferID, StartPage (2 bytes), PageNum (2 bytes), MSB first
+#define FINGERPRINT_REGMODEL 0x05
+#define FINGERPRINT_STORE 0x06
+#define FINGERPRINT_LOADCHAR 0x07 // Args: BufferID, PageID (2 bytes)
+#define FINGERPRINT_VERIFYPASSWORD 0x13
+#define FINGERPRINT_TEMPLATECOUNT 0x1D
+#define FINGERPRINT_ENROLLSTART 0x22
+#define FINGERPRINT_ENROLL1 0x23
+#define FINGERPRINT_ENROLL2 0x24
+#define FINGERPRINT_ENROLL3 0x25
+#define CHARBUFFER1 0x01
+#define CHARBUFFER2 0x02
+
+// Confirmation codes (first payload byte of an ACK packet)
+#define FINGERPRINT_OK 0x00
+#define FINGERPRINT_PACKETRECIEVEERR 0x01
+#define FINGERPRINT_NOFINGER 0x02
+#define FINGERPRINT_NOMATCH 0x08
+#define FINGERPRINT_NOTFOUND 0x09
+#define FINGERPRINT_BADLOCATION 0x0B
+#define FINGERPRINT_DBREADFAIL 0x0C
+#define FINGERPRINT_PASSFAIL 0x13
+#define FINGERPRINT_INVALIDIMAGE 0x15
+#define FINGERPRINT_NEEDPASSWORD 0x21
+
+// Link-layer failures, returned in place of a confirmation code
+#define FINGERPRINT_LINK_TIMEOUT -1
+
+// Byte the sensor emits once after power-up; seeing it means we must log in again
+#define FINGERPRINT_HANDSHAKE 0x55
+
+// Largest reply payload we accept (confirmation code + data, no checksum).
+// Anything longer is treated as garbage and triggers a resync.
+#define FINGERPRINT_MAX_PAYLOAD 32
+// Largest packet on the wire: header, address, type, length, payload, checksum
+#define FINGERPRINT_MAX_PACKET (11 + FINGERPRINT_MAX_PAYLOAD)
+// Command arguments fingerprint_encode_command() keeps; the rest are cut off
+#define FINGERPRINT_MAX_ARGS (FINGERPRINT_MAX_PAYLOAD - 1)
+
+// Link timing. The sensor needs a few hundred ms for GETIMAGE/SEARCH; once a
+// packet has started, bytes arrive back to back (~174 us each at 57.6k).
+#define FINGERPRINT_ACK_TIMEOUT_US 1000000
+#define FINGERPRINT_BYTE_TIMEOUT_US 2000
+#define FINGERPRINT_MAX_RETRIES 3
+
+// A validated packet. data[] holds the payload without the trailing checksum,
+// so for an ACK data[0] is the confirmation code.
+typedef struct {
+    uint8_t type;
+    uint16_t length;
+    uint8_t data[FINGERPRINT_MAX_PAYLOAD];
+} fingerprint_packet;
+
+// Incremental packet parser; feed it one received byte at a time.
+typedef struct {
+    uint8_t state;
+    uint16_t idx;
+    uint16_t sum;          // Of the type and length bytes
+    uint16_t rx_checksum;
+    fingerprint_packet packet;
+} fingerprint_parser;
+
+#define FINGERPRINT_PARSE_INCOMPLETE 0
+#define FINGERPRINT_PARSE_COMPLETE 1
+#define FINGERPRINT_PARSE_ERROR 2
+
+// Link health counters, cumulative since boot
+typedef struct {
+    uint32_t checksum_failures; // Framed packets whose checksum did not match
+    uint32_t resyncs;           // Times we dropped bytes and hunted for 0xEF01
+    uint32_t timeouts;          // Missing or late ACKs
+    uint32_t retries;           // Commands re-issued after a failure
+    uint32_t reverifies;        // VERIFYPASSWORD re-runs after a sensor reset
+    uint32_t stale_bytes;       // Late bytes flushed before sending a command
+    uint32_t recoveries;        // Commands that got a valid ACK after a failed attempt
+    uint64_t recovery_us;       // Total time from sending the failed attempt to that ACK
+} fingerprint_link_stats;
+
+extern fingerprint_link_stats g_fingerprint_stats;
+
+// Pages in the sensor library that a full SEARCH covers
+#define FINGERPRINT_LIBRARY_PAGES 200
+
+// Recently matched pages, tried with a one-page SEARCH before the full
+// search. Each is ranked by a match count that halves every
+// FINGERPRINT_RECENT_DECAY decisions. The best few are probed in that order,
+// as many as save the most on average: each hit saves the full-search time,
+// and each probe reached costs the measured time of a one-page SEARCH.
+#define FINGERPRINT_RECENT_SIZE 4
+#define FINGERPRINT_RECENT_DECAY 64
+
+// Matching statistics, cumulative since boot. Only scans where a finger was
+// captured count; latency runs from GETIMAGE to the decision.
+typedef struct {
+    uint32_t decisions;
+    uint32_t fast_hits;      // Found by a one-page search of a recent page
+    uint32_t fast_misses;    // Recent pages tried, fell back to the full search
+    uint32_t full_matches;   // Found by the full search
+    uint32_t no_matches;     // Not in the library at all
+    uint64_t hit_us;         // Total latency of fast-path hits
+    uint64_t miss_us;        // Total latency of everything else
+    uint32_t max_us;
+} fingerprint_match_stats;
+
+extern fingerprint_match_stats g_fingerprint_match_stats;
+
+void fingerprint_parser_reset(fingerprint_parser *parser);
+int fingerprint_parser_feed(fingerprint_parser *parser, uint8_t byte, fingerprint_link_stats *stats);
+uint16_t fingerprint_encode_packet(uint8_t *packet, uint8_t type, const uint8_t *payload, uint16_t payload_len);
+uint16_t fingerprint_encode_command(uint8_t *packet, uint8_t command, const uint8_t *args, uint8_t args_len);
+
+void send_fingerprint_command(uint8_t command, uint8_t *args, uint8_t args_len);
+int fingerprint_read_reply(fingerprint_packet *reply, uint32_t timeout_us);
+int fingerprint_command(uint8_t command, uint8_t *args, uint8_t args_len, fingerprint_packet *reply);
+void fingerprint_command_start(uint8_t command, uint8_t *args, uint8_t args_len);
+int fingerprint_command_finish(uint8_t command, uint8_t *args, uint8_t args_len, fingerprint_packet *reply);
+int fingerprint_link_init(uint32_t password);
+bool fingerprint_match(uint16_t *page_id);
+bool fingerprint_identify(uint8_t buffer, uint16_t *page_id, uint32_t start_us);
+uint32_t fingerprint_now_us();
+void fingerprint_recent_configure(uint8_t size);
+
+#endif
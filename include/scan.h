@@ -0,0 +1,58 @@
+/* Continuous scanning
+ *
+ * A scan loop that keeps the sensor busy. Each call to scan_step()
+ * finishes one scan and, before returning, already sends the GETIMAGE for
+ * the next one, so whatever the caller does with the result (turning the
+ * servo, logging) overlaps the next capture. After a decision, captures
+ * only watch for the finger lifting: while the glass stays occupied,
+ * scan_step() reports SCAN_DUPLICATE without converting or searching the
+ * image, so a capture takes one GETIMAGE and the next person's finger is
+ * picked up within one of them. A finger swapped for another faster than
+ * that counts as the same one until it lifts.
+ *
+ * The sensor must not be sent other commands between scan_begin() and the
+ * last scan_step(); call scan_end() first.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include "ee14lib.h"
+
+// scan_result.outcome
+#define SCAN_NO_FINGER 0
+#define SCAN_MATCHED 1
+#define SCAN_REJECTED 2
+#define SCAN_DUPLICATE 3 // Same finger as the last decision, still on the glass
+#define SCAN_ERROR 4     // Bad image or the link gave up; scanning continues
+
+// Decision latency histogram: 10 ms buckets, the last one catching
+// everything above 1.27 s
+#define SCAN_LATENCY_BUCKET_US 10000
+#define SCAN_LATENCY_BUCKETS 128
+
+typedef struct {
+    int outcome;
+    bool matched;        // Whether the decision (or, for a duplicate, the original one) was a match
+    uint16_t page_id;    // Matching page when matched
+    uint32_t latency_us; // From the GETIMAGE that captured the finger to the decision
+} scan_result;
+
+// Cumulative since boot
+typedef struct {
+    uint32_t decisions;  // SCAN_MATCHED + SCAN_REJECTED
+    uint32_t matches;
+    uint32_t duplicates;
+    uint32_t no_finger;
+    uint32_t errors;
+    uint32_t latency_hist[SCAN_LATENCY_BUCKETS]; // Decisions only
+} scan_stats;
+
+extern scan_stats g_scan_stats;
+
+void scan_begin();
+void scan_step(scan_result *result);
+void scan_end();
+uint32_t scan_latency_percentile(uint32_t percent);
+
+#endif
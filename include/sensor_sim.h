@@ -0,0 +1,65 @@
+/* Simulated fingerprint sensor
+ *
+ * A ZFM-20 model the link layer talks to in place of USART1 when built
+ * with FINGERPRINT_LINK_SIM (the sim environments and unit tests), for
+ * benchmarking matching strategies without a sensor or a finger. It parses
+ * command packets, answers GETIMAGE, IMAGE2TZ, SEARCH, LOADCHAR and MATCH
+ * from a set of enrolled pages and a "finger on the glass", and delays each
+ * reply by a per-command processing time plus 57.6k byte times. The line
+ * can be made noisy at a given bit error rate, to exercise link recovery,
+ * and reply bytes that arrive while the firmware isn't reading are lost
+ * once USART1 has no room for them (sensor_sim_rx_depth()).
+ *
+ * Time is virtual: waiting for a reply advances a simulated microsecond
+ * clock (sensor_sim_now_us()) instead of spinning, so thousands of decisions
+ * run in a moment.
+ */
+
+#ifndef SENSOR_SIM_H
+#define SENSOR_SIM_H
+
+#include "ee14lib.h"
+
+// Pages the simulated sensor library has (the ZFM-20 holds 200 templates)
+#define SENSOR_SIM_PAGES 200
+
+// Fingers are identified by the page they are enrolled at. Any other value
+// from SENSOR_SIM_PAGES up is a finger that isn't enrolled (different values
+// are different fingers), except SENSOR_SIM_NO_FINGER.
+#define SENSOR_SIM_NO_FINGER 0xFFFF
+#define SENSOR_SIM_UNKNOWN_FINGER 0xFFFE
+
+// Called at each GETIMAGE for the finger on the glass at that moment
+typedef uint16_t (*sensor_sim_finger_fn)(uint32_t now_us);
+
+// Processing time of each command, from the end of the command packet to
+// the first reply byte. SEARCH scans page by page and stops at a match.
+typedef struct {
+    uint32_t getimage_us;
+    uint32_t image2tz_us;
+    uint32_t search_base_us;
+    uint32_t search_page_us;
+    uint32_t loadchar_us;
+    uint32_t match_us;
+    uint32_t other_us;
+} sensor_sim_timing;
+
+extern const sensor_sim_timing SENSOR_SIM_ZFM20_TIMING;
+
+void sensor_sim_begin(const sensor_sim_timing *timing);
+void sensor_sim_end();
+bool sensor_sim_active();
+void sensor_sim_enroll(uint16_t page_id);
+void sensor_sim_place_finger(uint16_t finger);
+void sensor_sim_finger_source(sensor_sim_finger_fn source);
+uint32_t sensor_sim_now_us();
+void sensor_sim_idle(uint32_t us);
+void sensor_sim_noise(uint32_t ber_ppm, uint32_t seed);
+void sensor_sim_rx_depth(uint16_t depth);
+uint32_t sensor_sim_rx_dropped();
+
+void sensor_sim_tx(uint8_t byte);
+int sensor_sim_rx(uint32_t timeout_us);
+int sensor_sim_flush();
+
+#endif
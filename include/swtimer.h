@@ -0,0 +1,46 @@
+/* Software timers on a hardware timer
+ *
+ * One-shot and periodic timers for scheduling things like "close the lid in
+ * 400 ms" without a blocking delay. TIM16 ticks every SWTIMER_TICK_MS and
+ * pends PendSV; the PendSV handler (lowest priority, so it never delays a
+ * real interrupt) advances a hashed timing wheel and runs the callbacks of
+ * expired timers.
+ *
+ * Timers live in the wheel as intrusive doubly-linked list nodes, so arm and
+ * cancel are O(1) and nothing is allocated: callers own the swtimer structs,
+ * normally as statics. Callbacks may arm or cancel any timer, including
+ * their own.
+ *
+ * TIM16 is taken by this service, so it can't also be used for PWM.
+ */
+
+#ifndef SWTIMER_H
+#define SWTIMER_H
+
+#include "ee14lib.h"
+#include <stddef.h>
+
+#define SWTIMER_TICK_MS 1
+// Wheel size; must be a power of two. Timers further out than this many
+// ticks just stay in their slot for extra laps around the wheel.
+#define SWTIMER_WHEEL_SLOTS 64
+
+typedef void (*swtimer_callback)(void *arg);
+
+typedef struct swtimer {
+    struct swtimer *next;
+    struct swtimer *prev;
+    uint32_t expires;          // Absolute tick
+    uint32_t period;           // Ticks between periodic firings, 0 for one-shot
+    swtimer_callback callback;
+    void *arg;
+} swtimer;
+
+EE14Lib_Err swtimer_init();
+void swtimer_arm(swtimer *timer, uint32_t delay_ms, uint32_t period_ms,
+                 swtimer_callback callback, void *arg);
+void swtimer_cancel(swtimer *timer);
+bool swtimer_armed(const swtimer *timer);
+uint32_t swtimer_now_ms();
+
+#endif
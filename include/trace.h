@@ -0,0 +1,48 @@
+/* USART1 traffic capture and replay
+ *
+ * Capture timestamps every byte the link layer sends or receives into a
+ * RAM buffer, which trace_dump() drains over the serial monitor. Replay
+ * feeds a captured trace back into the link layer in place of USART1, with
+ * the original reply timing, so decisions and latency can be compared
+ * across firmware revisions (see src/replay.cpp).
+ *
+ * Trace format: one entry per byte,
+ *   varint((delta_us << 1) | direction)  byte
+ * where delta_us is the time since the previous entry and the varint is
+ * LEB128 (7 bits per byte, high bit set on all but the last byte). Bytes
+ * of one packet are ~174 us apart at 57.6k, so most entries take 3 bytes.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "ee14lib.h"
+
+#define TRACE_TX 0 // Firmware -> sensor
+#define TRACE_RX 1 // Sensor -> firmware
+
+// RAM set aside for capture; recording stops (and counts drops) when full.
+// Only the capture build (FINGERPRINT_TRACE) pays for a real buffer.
+#ifdef FINGERPRINT_TRACE
+#define TRACE_BUFFER_SIZE 4096
+#else
+#define TRACE_BUFFER_SIZE 8
+#endif
+
+void trace_start();
+void trace_stop();
+void trace_record(uint8_t direction, uint8_t byte, uint32_t now_us);
+void trace_dump(USART_TypeDef *USARTx);
+
+// Replay is only built where the link reads from a trace (FINGERPRINT_REPLAY)
+#ifdef FINGERPRINT_REPLAY
+void trace_replay_begin(const uint8_t *trace, uint32_t len);
+bool trace_replay_done();
+uint32_t trace_replay_mismatches();
+void trace_replay_tx(uint8_t byte);
+int trace_replay_rx(uint32_t timeout_us);
+int trace_replay_flush();
+#endif
+uint32_t trace_now_us();
+
+#endif
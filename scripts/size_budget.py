@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Per-module .text/.data/.bss report from the linker map, checked against budgets.
+
+Used two ways:
+
+  * As a PlatformIO extra script (see platformio.ini). It adds -Map to the
+    link, and after every link prints the report and fails the build when a
+    budget is exceeded or a forbidden object got linked in.
+  * Standalone, on an existing map:
+        python3 scripts/size_budget.py .pio/build/nucleo_l432kc/firmware.map \
+            --budget total:flash=258048 --forbid '*sf3.o'
+
+Budgets are "<module>:<kind>=<bytes>". <module> is a source object such as
+main.cpp, an archive such as libc.a, or "total". <kind> is text, data, bss,
+flash (text + data, since initialized data is stored in flash too) or ram
+(data + bss). Forbid patterns are shell globs matched against object names,
+e.g. '_arm_*sf*.o' catches the soft-float helpers from libgcc.
+"""
+
+import fnmatch
+import os
+import re
+import sys
+
+# Output sections, by which kind of memory they take. Anything else
+# (debug info, .ARM.attributes, ...) isn't loaded and is ignored.
+TEXT_SECTIONS = (".isr_vector", ".text", ".rodata", ".ARM.extab", ".ARM", ".ARM.exidx",
+                 ".preinit_array", ".init_array", ".fini_array")
+DATA_SECTIONS = (".data",)
+BSS_SECTIONS = (".bss", "._user_heap_stack")
+
+INPUT_RE = re.compile(r"^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$")
+ARCHIVE_RE = re.compile(r"([^/\\]+\.a)\(([^)]+)\)$")
+
+
+def module_of(path):
+    """Map an input file to (module, object): 'src/gpio.cpp.o' -> ('gpio.cpp', ...)."""
+    m = ARCHIVE_RE.search(path)
+    if m:
+        return m.group(1), m.group(2)
+    name = os.path.basename(path)
+    if name.endswith(".o"):
+        name = name[:-2]
+    return name, os.path.basename(path)
+
+
+def parse_map(path):
+    """Return ({module: {text, data, bss}}, set of object names) for a GNU ld map."""
+    sizes = {}
+    objects = set()
+    kind = None
+    pending = None  # Input section name that wrapped onto the next line
+    in_memory_map = False
+
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map or not line.strip():
+                continue
+
+            # Output section header, e.g. ".text  0x08000190  0x1234"
+            if not line[0].isspace():
+                name = line.split()[0]
+                if name in TEXT_SECTIONS:
+                    kind = "text"
+                elif name in DATA_SECTIONS:
+                    kind = "data"
+                elif name in BSS_SECTIONS:
+                    kind = "bss"
+                else:
+                    kind = None
+                pending = None
+                continue
+            if kind is None:
+                continue
+
+            stripped = line.strip()
+            if stripped.startswith("*fill*") or stripped.startswith("*("):
+                continue
+
+            # Input section: " .text.foo 0xADDR 0xSIZE file.o", possibly with
+            # the section name alone on the line before the numbers.
+            parts = stripped.split()
+            if len(parts) == 1 and parts[0].startswith("."):
+                pending = parts[0]
+                continue
+            if parts and (parts[0].startswith(".") or parts[0] == "COMMON") and len(parts) >= 4:
+                rest = "  " + " ".join(parts[1:])
+            elif pending is not None:
+                rest = line
+            else:
+                continue
+            pending = None
+
+            m = INPUT_RE.match(rest)
+            if not m:
+                continue
+            size = int(m.group(2), 16)
+            if size == 0:
+                continue
+            module, obj = module_of(m.group(3).strip())
+            objects.add(obj)
+            entry = sizes.setdefault(module, {"text": 0, "data": 0, "bss": 0})
+            entry[kind] += size
+
+    return sizes, objects
+
+
+def amount(entry, kind):
+    if kind == "flash":
+        return entry["text"] + entry["data"]
+    if kind == "ram":
+        return entry["data"] + entry["bss"]
+    return entry[kind]
+
+
+def parse_budgets(lines):
+    budgets = []
+    for item in lines:
+        item = item.strip()
+        if not item or item.startswith(";") or item.startswith("#"):
+            continue
+        target, limit = item.split("=")
+        module, kind = target.strip().rsplit(":", 1)
+        if kind not in ("text", "data", "bss", "flash", "ram"):
+            raise ValueError("unknown budget kind in '%s'" % item)
+        budgets.append((module, kind, int(limit, 0)))
+    return budgets
+
+
+def check(map_path, budgets, forbid):
+    """Print the report; return a list of failure messages."""
+    sizes, objects = parse_map(map_path)
+    total = {"text": 0, "data": 0, "bss": 0}
+    for entry in sizes.values():
+        for k in total:
+            total[k] += entry[k]
+
+    print("%-24s %8s %8s %8s" % ("module", "text", "data", "bss"))
+    for module in sorted(sizes, key=lambda m: -amount(sizes[m], "flash")):
+        e = sizes[module]
+        print("%-24s %8d %8d %8d" % (module, e["text"], e["data"], e["bss"]))
+    print("%-24s %8d %8d %8d" % ("total", total["text"], total["data"], total["bss"]))
+
+    failures = []
+    for module, kind, limit in budgets:
+        entry = total if module == "total" else sizes.get(module, {"text": 0, "data": 0, "bss": 0})
+        used = amount(entry, kind)
+        status = "OK  " if used <= limit else "OVER"
+        print("budget %s %s:%s %d / %d" % (status, module, kind, used, limit))
+        if used > limit:
+            failures.append("%s:%s is %d bytes, budget %d" % (module, kind, used, limit))
+
+    for pattern in forbid:
+        for obj in sorted(fnmatch.filter(objects, pattern)):
+            failures.append("forbidden object %s linked (matches %s)" % (obj, pattern))
+
+    for msg in failures:
+        print("size budget: " + msg)
+    return failures
+
+
+def main(argv):
+    import argparse
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="linker map file")
+    parser.add_argument("--budget", action="append", default=[], help="<module>:<kind>=<bytes>")
+    parser.add_argument("--forbid", action="append", default=[], help="glob of object names that must not be linked")
+    args = parser.parse_args(argv)
+    return 1 if check(args.map, parse_budgets(args.budget), args.forbid) else 0
+
+
+def platformio_hook(env):
+    map_path = os.path.join(env.subst("$BUILD_DIR"), "firmware.map")
+    env.Append(LINKFLAGS=["-Wl,-Map=" + map_path])
+
+    def after_link(target, source, env):
+        budgets = parse_budgets(env.GetProjectOption("custom_size_budget", "").splitlines())
+        forbid = env.GetProjectOption("custom_size_forbid", "").split()
+        if check(map_path, budgets, forbid):
+            env.Exit(1)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", after_link)
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
+else:
+    Import("env")  # noqa: F821 -- provided by SCons when run by PlatformIO
+    platformio_hook(env)  # noqa: F821
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Turn a captured USART1 trace into include/replay_trace.h for the replay env.
+
+Build the 'trace' environment, run it with the serial monitor logged to a
+file, then:
+
+    python3 scripts/trace_to_header.py monitor.log            # writes include/replay_trace.h
+    python3 scripts/trace_to_header.py monitor.log --list     # decode to text instead
+    pio run -e replay -t upload
+
+Every 'trace,<hex>' line in the log is concatenated in order; any other
+console output is ignored. Each dump ends with 'trace,end,<bytes>,<dropped>,
+<crc32>'; a dump whose length or CRC-32 doesn't match what was received
+(a byte lost or garbled on the serial monitor) is an error, and so is a dump
+with no end line. If the log was only cut off partway through its last dump,
+--allow-partial keeps the whole entries of that dump, unchecked.
+See include/trace.h for the entry format.
+"""
+
+import argparse
+import os
+import sys
+import zlib
+
+HEADER = os.path.join(os.path.dirname(__file__), "..", "include", "replay_trace.h")
+
+
+def whole_entries(block):
+    """Length of the longest prefix of block made of complete entries."""
+    pos, end = 0, 0
+    while pos < len(block):
+        while pos < len(block) and block[pos] & 0x80:
+            pos += 1
+        pos += 2  # Last varint byte, then the data byte
+        if pos <= len(block):
+            end = pos
+    return end
+
+
+def read_trace(path, allow_partial=False):
+    data = bytearray()
+    block = bytearray()  # Bytes of the dump being read
+    in_dump = False      # Seen trace lines since the last end line
+    dumps = 0
+    with open(path, errors="replace") as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip()
+            if not line.startswith("trace,"):
+                continue
+            fields = line.split(",")
+            if fields[1] == "begin":
+                if in_dump:
+                    sys.exit("line %d: trace dump %d has no end line" % (number, dumps + 1))
+                block = bytearray()
+                in_dump = True
+            elif fields[1] == "end":
+                dumps += 1
+                try:
+                    length, crc = int(fields[2]), int(fields[4], 16)
+                except (IndexError, ValueError):
+                    sys.exit("line %d: bad trace end line" % number)
+                if length != len(block) or crc != zlib.crc32(block):
+                    sys.exit("trace dump %d is corrupted (length or CRC-32 mismatch)" % dumps)
+                data += block
+                block = bytearray()
+                in_dump = False
+            else:
+                try:
+                    block += bytes.fromhex(fields[1])
+                except ValueError:
+                    if allow_partial:
+                        break  # Most likely the log's last line, cut short
+                    sys.exit("line %d: bad trace line" % number)
+                in_dump = True
+
+    if in_dump:
+        if not allow_partial:
+            sys.exit("trace dump %d has no end line (log cut off?); "
+                     "--allow-partial keeps it unchecked" % (dumps + 1))
+        data += block[:whole_entries(block)]
+    return bytes(data)
+
+
+def decode(data):
+    """Yield (time_us, direction, byte) for every entry."""
+    pos, now = 0, 0
+    while pos < len(data):
+        value, shift = 0, 0
+        while True:
+            b = data[pos]
+            pos += 1
+            value |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        now += value >> 1
+        yield now, "RX" if value & 1 else "TX", data[pos]
+        pos += 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="serial monitor log containing trace lines")
+    parser.add_argument("-o", "--output", default=HEADER, help="header to write")
+    parser.add_argument("--list", action="store_true", help="print decoded entries and exit")
+    parser.add_argument("--allow-partial", action="store_true",
+                        help="keep a last dump that has no end line, without checking it")
+    args = parser.parse_args()
+
+    data = read_trace(args.log, args.allow_partial)
+    if not data:
+        sys.exit("no trace lines found in " + args.log)
+
+    if args.list:
+        for t, direction, byte in decode(data):
+            print("%10d us  %s  %02X" % (t, direction, byte))
+        return
+
+    with open(args.output, "w") as f:
+        f.write("// Generated by scripts/trace_to_header.py from %s\n" % os.path.basename(args.log))
+        f.write("#include <stdint.h>\n\n")
+        f.write("static const uint8_t g_replay_trace[%d] = {\n" % len(data))
+        for i in range(0, len(data), 16):
+            f.write("    " + ", ".join("0x%02X" % b for b in data[i:i + 16]) + ",\n")
+        f.write("};\n")
+    print("wrote %d bytes to %s" % (len(data), args.output))
+
+
+if __name__ == "__main__":
+    main()
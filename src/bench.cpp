@@ -0,0 +1,362 @@
+/* Microbenchmarks for the protocol, GPIO and timer hot paths
+ *
+ * Built in place of main.cpp by the "bench" PlatformIO environment for the
+ * board, and by "bench_native" for a PC, where the drivers run against the
+ * simulated peripherals in src/host. Each benchmark runs a fixed number of
+ * iterations timed with the DWT cycle counter, minus the cost of an empty
+ * iteration. Results are printed on the serial monitor (stdout on a PC) as
+ * CSV so they can be diffed or gated in a script:
+ *
+ *   bench,name,iterations,cycles_per_op,ns_per_op,core_hz
+ *   bench,encode_search,<iterations>,<cycles_per_op>,<ns_per_op>,<core_hz>
+ *   ...
+ *   latency,name,iterations,avg_cycles,max_cycles,avg_ns,max_ns,core_hz
+ *   latency,swtimer_tick_to_callback_1024,<iterations>,...
+ *   bench,done
+ *
+ * On a PC the counter runs at 1 GHz, so cycles_per_op is ns/op there. The
+ * checksum benchmarks run over one 139-byte ZFM data packet, so their
+ * bytes/cycle is 139 / cycles_per_op; the CRCs use the CRC unit on the
+ * board and the table-driven code on a PC.
+ *
+ * The swtimer benchmarks run with 1024 timers outstanding and TIM16 stopped,
+ * ticking the wheel by hand (bench_tick()) so that no real tick lands in a
+ * timed loop. The latency line is not a per-op cost but the cycles from a
+ * tick to the callback of the timer due on it, average and worst case over
+ * the iterations.
+ */
+
+#include "ee14lib.h"
+#include "fingerprint.h"
+#include "swtimer.h"
+#include "checksum.h"
+#ifdef EE14LIB_HOST
+#include "host.h"
+#endif
+
+// Serial monitor print helper
+#define printf(msg) serial_write(USART2, msg, sizeof(msg) - 1)
+
+typedef void (*bench_fn)(uint32_t i);
+
+typedef struct {
+    const char *name;
+    bench_fn fn;
+    uint32_t iterations;
+    bool prints; // Writes to the serial monitor itself
+} benchmark;
+
+// Results are written here so the compiler can't drop the work
+static volatile uint32_t g_sink;
+
+// A SEARCH reply (match on page 5, score 64), filled in by make_search_ack()
+static uint8_t g_search_ack[FINGERPRINT_MAX_PACKET];
+static uint16_t g_search_ack_len;
+
+
+/* make_search_ack
+   Purpose: Builds a valid SEARCH ACK packet for the parser benchmark
+   Arguments: None
+   Returns: None
+*/
+static void make_search_ack() {
+    const uint8_t payload[] = {FINGERPRINT_OK, 0x00, 0x05, 0x00, 0x40};
+    g_search_ack_len = fingerprint_encode_packet(g_search_ack, FINGERPRINT_ACKPACKET,
+                                                 payload, sizeof(payload));
+}
+
+static void bench_empty(uint32_t i) {
+    g_sink = i;
+}
+
+static void bench_encode_search(uint32_t i) {
+    uint8_t packet[FINGERPRINT_MAX_PACKET];
+    // BufferID, StartPage 0, PageNum varying so the checksum can't be hoisted
+    uint8_t args[5] = {CHARBUFFER1, 0x00, 0x00, 0x00, (uint8_t)i};
+    g_sink = fingerprint_encode_command(packet, FINGERPRINT_SEARCH, args, 5) + packet[15];
+}
+
+static void bench_parse_search_ack(uint32_t i) {
+    fingerprint_parser parser;
+    fingerprint_link_stats stats;
+    int r = FINGERPRINT_PARSE_INCOMPLETE;
+    fingerprint_parser_reset(&parser);
+    for (unsigned int b = 0; b < g_search_ack_len; b++)
+        r = fingerprint_parser_feed(&parser, g_search_ack[b], &stats);
+    g_sink = r + i;
+}
+
+// A 139-byte data packet (128 bytes of image/template data plus framing)
+#define BENCH_PACKET_BYTES 139
+static uint8_t g_packet[BENCH_PACKET_BYTES];
+
+static void bench_sum16_bytewise(uint32_t i) {
+    g_sink = checksum_sum16_bytewise(i, g_packet, BENCH_PACKET_BYTES);
+}
+
+static void bench_sum16_swar(uint32_t i) {
+    g_sink = checksum_sum16_swar(i, g_packet, BENCH_PACKET_BYTES);
+}
+
+#ifdef CHECKSUM_HAVE_SIMD
+static void bench_sum16_simd(uint32_t i) {
+    g_sink = checksum_sum16_simd(i, g_packet, BENCH_PACKET_BYTES);
+}
+#endif
+
+static void bench_crc16(uint32_t i) {
+    g_sink = checksum_crc16_ccitt(g_packet, BENCH_PACKET_BYTES) + i;
+}
+
+static void bench_crc32(uint32_t i) {
+    g_sink = checksum_crc32(g_packet, BENCH_PACKET_BYTES) + i;
+}
+
+static void bench_crc32_soft(uint32_t i) {
+    g_sink = checksum_crc32_soft(g_packet, BENCH_PACKET_BYTES) + i;
+}
+
+static void bench_pwm_duty(uint32_t i) {
+    timer_set_pwm_duty(TIM2, A4, i & 1023);
+}
+
+static void bench_gpio_write(uint32_t i) {
+    gpio_write(D9, i & 1);
+}
+
+static void bench_gpio_read(uint32_t i) {
+    g_sink = gpio_read(A6) + i;
+}
+
+// Per-byte cost of the blocking UART path, including the settle delay in
+// UART_write_byte. Leaves a run of spaces on the serial monitor, so its
+// result goes on a fresh line.
+static void bench_serial_write_byte(uint32_t i) {
+    serial_write(USART2, " ", 1);
+    g_sink = i;
+}
+
+// Outstanding timers for the wheel benchmarks, armed far enough out that none
+// of them fire while they run
+#define BENCH_SWTIMERS 1024
+static swtimer g_bench_timers[BENCH_SWTIMERS];
+
+// Timer that the expire and jitter benchmarks arm for the next tick
+static swtimer g_bench_due;
+static volatile uint32_t g_bench_fired_cycles;
+
+static void bench_swtimer_noop(void *arg) {
+    (void)arg;
+}
+
+static void bench_swtimer_fired(void *arg) {
+    (void)arg;
+    g_bench_fired_cycles = cycle_counter_read();
+}
+
+/* bench_tick
+   Purpose: Advances the timer wheel by one tick, by hand: an update event
+            on the stopped TIM16 (its interrupt, then PendSV), or the same
+            handlers called in turn on a PC. Returns once PendSV has run.
+   Arguments: None
+   Returns: None
+*/
+static void bench_tick() {
+#ifdef EE14LIB_HOST
+    host_tim16_tick();
+#else
+    uint32_t now = swtimer_now_ms();
+    TIM16->EGR = TIM_EGR_UG;
+    // PendSV is tail-chained before we get back here, so once the tick
+    // count moves the wheel has been walked too
+    while (swtimer_now_ms() == now)
+        ;
+#endif
+}
+
+static void arm_bench_timers() {
+    for (uint32_t i = 0; i < BENCH_SWTIMERS; i++)
+        swtimer_arm(&g_bench_timers[i], 60000 + (i * 37) % 60000, 0, bench_swtimer_noop, NULL);
+}
+
+// Cancel + re-arm of one of BENCH_SWTIMERS outstanding timers
+static void bench_swtimer_rearm(uint32_t i) {
+    swtimer *t = &g_bench_timers[i % BENCH_SWTIMERS];
+    swtimer_cancel(t);
+    swtimer_arm(t, 60000 + (i * 37) % 60000, 0, bench_swtimer_noop, NULL);
+}
+
+// A tick with nothing due: interrupt, PendSV and the walk of one slot
+static void bench_swtimer_tick(uint32_t i) {
+    bench_tick();
+    g_sink = i;
+}
+
+// Arm a timer for the next tick and tick: the difference from
+// swtimer_tick_1024 is what arming and expiring one timer costs
+static void bench_swtimer_expire(uint32_t i) {
+    swtimer_arm(&g_bench_due, SWTIMER_TICK_MS, 0, bench_swtimer_noop, NULL);
+    bench_tick();
+    g_sink = i;
+}
+
+static const benchmark g_benchmarks[] = {
+    {"encode_search", bench_encode_search, 1000, false},
+    {"parse_search_ack", bench_parse_search_ack, 1000, false},
+    {"sum16_bytewise_139", bench_sum16_bytewise, 1000, false},
+    {"sum16_swar_139", bench_sum16_swar, 1000, false},
+#ifdef CHECKSUM_HAVE_SIMD
+    {"sum16_simd_139", bench_sum16_simd, 1000, false},
+#endif
+    {"crc16_139", bench_crc16, 1000, false},
+    {"crc32_139", bench_crc32, 1000, false},
+    {"crc32_soft_139", bench_crc32_soft, 100, false},
+    {"pwm_duty", bench_pwm_duty, 1000, false},
+    {"gpio_write", bench_gpio_write, 1000, false},
+    {"gpio_read", bench_gpio_read, 1000, false},
+    {"swtimer_rearm_1024", bench_swtimer_rearm, 1000, false},
+    {"swtimer_tick_1024", bench_swtimer_tick, 1000, false},
+    {"swtimer_expire_1024", bench_swtimer_expire, 1000, false},
+    {"serial_write_byte", bench_serial_write_byte, 16, true},
+};
+
+/* run_benchmark
+   Purpose: Times fn over a number of iterations
+   Arguments:
+    fn: Function to time
+    iterations: How many times to call it
+   Returns: Total elapsed cycles
+*/
+static uint32_t run_benchmark(bench_fn fn, uint32_t iterations) {
+    uint32_t start = cycle_counter_read();
+    for (uint32_t i = 0; i < iterations; i++) fn(i);
+    return cycle_counter_read() - start;
+}
+
+/* print_result
+   Purpose: Prints one benchmark CSV line
+   Arguments:
+    name: Benchmark name
+    iterations: Iterations it ran
+    per_op: Cycles per iteration
+   Returns: None
+*/
+static void print_result(const char *name, uint32_t iterations, uint32_t per_op) {
+    extern uint32_t SystemCoreClock;
+    uint32_t ns_per_op = (uint32_t)((uint64_t)per_op * 1000000000 / SystemCoreClock);
+
+    int name_len = 0;
+    while (name[name_len]) name_len++;
+
+    printf("bench,");
+    serial_write(USART2, name, name_len);
+    printf(",");
+    serial_write_uint(USART2, iterations);
+    printf(",");
+    serial_write_uint(USART2, per_op);
+    printf(",");
+    serial_write_uint(USART2, ns_per_op);
+    printf(",");
+    serial_write_uint(USART2, SystemCoreClock);
+    printf("\r\n");
+}
+
+/* print_latency
+   Purpose: Prints one latency CSV line
+   Arguments:
+    name: What was measured
+    iterations: Samples taken
+    avg: Average latency in cycles
+    max: Worst latency in cycles
+   Returns: None
+*/
+static void print_latency(const char *name, uint32_t iterations, uint32_t avg, uint32_t max) {
+    extern uint32_t SystemCoreClock;
+
+    int name_len = 0;
+    while (name[name_len]) name_len++;
+
+    printf("latency,");
+    serial_write(USART2, name, name_len);
+    printf(",");
+    serial_write_uint(USART2, iterations);
+    printf(",");
+    serial_write_uint(USART2, avg);
+    printf(",");
+    serial_write_uint(USART2, max);
+    printf(",");
+    serial_write_uint(USART2, (uint32_t)((uint64_t)avg * 1000000000 / SystemCoreClock));
+    printf(",");
+    serial_write_uint(USART2, (uint32_t)((uint64_t)max * 1000000000 / SystemCoreClock));
+    printf(",");
+    serial_write_uint(USART2, SystemCoreClock);
+    printf("\r\n");
+}
+
+/* bench_swtimer_jitter
+   Purpose: Arms a timer for the next tick, ticks, and measures the cycles
+            from the tick to its callback, many times over
+   Arguments:
+    iterations: Ticks to measure
+    avg: Set to the average latency in cycles
+    max: Set to the worst latency in cycles
+   Returns: None
+*/
+static void bench_swtimer_jitter(uint32_t iterations, uint32_t *avg, uint32_t *max) {
+    uint64_t total = 0;
+
+    *max = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        swtimer_arm(&g_bench_due, SWTIMER_TICK_MS, 0, bench_swtimer_fired, NULL);
+        uint32_t due = cycle_counter_read();
+        bench_tick();
+        uint32_t latency = g_bench_fired_cycles - due;
+        total += latency;
+        if (latency > *max) *max = latency;
+    }
+    *avg = (uint32_t)(total / iterations);
+}
+
+/* Benchmark driver
+   Purpose: Runs every benchmark once and prints one CSV line per result
+   Arguments: None
+   Returns: None--results are on the serial monitor (on a PC, returns 0
+    once they are printed)
+*/
+int main() {
+    host_serial_init();
+    gpio_config_mode(D9, OUTPUT);
+    gpio_config_mode(A6, INPUT);
+    timer_config_pwm(TIM2, 50);
+    timer_config_channel_pwm(TIM2, A4, 51);
+    cycle_counter_init();
+    swtimer_init();
+    TIM16->CR1 &= ~TIM_CR1_CEN; // Ticks come from bench_tick() only
+    arm_bench_timers();
+    make_search_ack();
+    for (int i = 0; i < BENCH_PACKET_BYTES; i++) g_packet[i] = i * 7 + 3;
+
+    printf("bench,name,iterations,cycles_per_op,ns_per_op,core_hz\r\n");
+
+    for (unsigned int b = 0; b < sizeof(g_benchmarks) / sizeof(g_benchmarks[0]); b++) {
+        const benchmark *bm = &g_benchmarks[b];
+        uint32_t overhead = run_benchmark(bench_empty, bm->iterations);
+        uint32_t cycles = run_benchmark(bm->fn, bm->iterations);
+        uint32_t per_op = cycles > overhead ? (cycles - overhead) / bm->iterations : 0;
+
+        if (bm->prints) printf("\r\n");
+        print_result(bm->name, bm->iterations, per_op);
+    }
+
+    uint32_t jitter_avg, jitter_max;
+    bench_swtimer_jitter(1000, &jitter_avg, &jitter_max);
+    printf("latency,name,iterations,avg_cycles,max_cycles,avg_ns,max_ns,core_hz\r\n");
+    print_latency("swtimer_tick_to_callback_1024", 1000, jitter_avg, jitter_max);
+    printf("bench,done\r\n");
+
+#ifdef EE14LIB_HOST
+    return 0;
+#endif
+    while (1)
+        ;
+}
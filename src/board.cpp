@@ -0,0 +1,53 @@
+#include "board.h"
+
+// Pins of the lockbox board, in addition to the two serial ports. The servo
+// pin (A4 = PA5, TIM2_CH1) is left to timer_config_channel_pwm(), which owns
+// its alternate-function number.
+static constexpr board_pin g_lockbox_pins[] = {
+    BOARD_SERIAL_PINS,
+    {BOARD_PORT_A, 8, OUTPUT, 0, PULL_OFF, LOW_SPD, PUSH_PULL}, // D9
+    {BOARD_PORT_A, 7, INPUT, 0, PULL_OFF, LOW_SPD, PUSH_PULL},  // A6, match input from the AD2
+};
+static_assert(board_pins_valid(g_lockbox_pins), "lockbox pin table has a duplicate or out-of-range entry");
+
+static constexpr board_config g_lockbox_board =
+    board_compile(g_lockbox_pins, BOARD_SERIAL_APB1ENR1, BOARD_SERIAL_APB2ENR);
+
+static GPIO_TypeDef *const g_board_gpio[BOARD_PORTS] = {GPIOA, GPIOB, GPIOC, GPIOH};
+
+// Write one register: only the bits in mask change, and untouched
+// registers aren't even read.
+static void apply_field(volatile uint32_t *reg, uint32_t mask, uint32_t value) {
+    if (mask) *reg = (*reg & ~mask) | value;
+}
+
+// Turn on every clock the board needs, then configure each GPIO port with a
+// single read-modify-write per register. MODER goes last so a pin only
+// switches to its new mode once its function, pull and drive are set.
+void board_apply(const board_config *cfg)
+{
+    RCC->AHB2ENR |= cfg->ahb2enr;
+    RCC->APB1ENR1 |= cfg->apb1enr1;
+    RCC->APB2ENR |= cfg->apb2enr;
+    (void)RCC->AHB2ENR; // Read back so the clocks are running before the first GPIO access
+
+    for (int p = 0; p < BOARD_PORTS; p++) {
+        const board_port *port = &cfg->ports[p];
+        GPIO_TypeDef *gpio = g_board_gpio[p];
+
+        apply_field(&gpio->AFR[0], port->afr_mask[0], port->afr[0]);
+        apply_field(&gpio->AFR[1], port->afr_mask[1], port->afr[1]);
+        apply_field(&gpio->OTYPER, port->otyper_mask, port->otyper);
+        apply_field(&gpio->OSPEEDR, port->ospeedr_mask, port->ospeedr);
+        apply_field(&gpio->PUPDR, port->pupdr_mask, port->pupdr);
+        apply_field(&gpio->MODER, port->moder_mask, port->moder);
+    }
+}
+
+// Bring up the whole lockbox board: every pin and clock in one pass, then
+// both serial ports (see serial_start()).
+void board_init()
+{
+    board_apply(&g_lockbox_board);
+    serial_start();
+}
@@ -0,0 +1,198 @@
+/* Checksums and CRCs
+ *
+ * The word-at-a-time sums load through memcpy, which compiles to a single
+ * LDR (the M4 allows unaligned word loads) without breaking aliasing rules.
+ */
+
+#include "checksum.h"
+#include <string.h>
+
+#ifdef __arm__
+#include "ee14lib.h" // CRC unit registers, __USADA8, __REV
+#endif
+
+// Largest number of words the SWAR sum can add before a 16-bit lane could
+// overflow: each word adds at most 2 * 255 to a lane.
+#define SWAR_MAX_WORDS 128
+
+static uint32_t load_word(const uint8_t *p) {
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+/* checksum_sum16_bytewise
+   Purpose: Reference 16-bit additive checksum, one byte at a time
+   Arguments:
+    sum: Running sum to continue from (0 to start)
+    data: Bytes to add
+    len: Number of bytes
+   Returns: sum plus every byte, modulo 2^16
+*/
+uint16_t checksum_sum16_bytewise(uint16_t sum, const uint8_t *data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) sum += data[i];
+    return sum;
+}
+
+/* checksum_sum16_swar
+   Purpose: 16-bit additive checksum, four bytes per step in plain C: the
+            even and odd bytes of each word are added into two 16-bit lanes
+   Arguments:
+    sum: Running sum to continue from (0 to start)
+    data: Bytes to add
+    len: Number of bytes
+   Returns: sum plus every byte, modulo 2^16
+*/
+uint16_t checksum_sum16_swar(uint16_t sum, const uint8_t *data, uint32_t len) {
+    while (len >= 4) {
+        uint32_t words = len / 4 < SWAR_MAX_WORDS ? len / 4 : SWAR_MAX_WORDS;
+        uint32_t lanes = 0;
+        for (uint32_t i = 0; i < words; i++, data += 4) {
+            uint32_t w = load_word(data);
+            lanes += w & 0x00FF00FF;
+            lanes += (w >> 8) & 0x00FF00FF;
+        }
+        sum += (lanes & 0xFFFF) + (lanes >> 16);
+        len -= words * 4;
+    }
+    return checksum_sum16_bytewise(sum, data, len);
+}
+
+#ifdef CHECKSUM_HAVE_SIMD
+/* checksum_sum16_simd
+   Purpose: 16-bit additive checksum with USADA8, which adds the four bytes
+            of a word to an accumulator in one instruction
+   Arguments:
+    sum: Running sum to continue from (0 to start)
+    data: Bytes to add
+    len: Number of bytes
+   Returns: sum plus every byte, modulo 2^16
+*/
+uint16_t checksum_sum16_simd(uint16_t sum, const uint8_t *data, uint32_t len) {
+    uint32_t acc0 = sum, acc1 = 0;
+
+    // Two accumulators so back-to-back USADA8s don't wait on each other
+    for (; len >= 8; len -= 8, data += 8) {
+        acc0 = __USADA8(load_word(data), 0, acc0);
+        acc1 = __USADA8(load_word(data + 4), 0, acc1);
+    }
+    return checksum_sum16_bytewise((uint16_t)(acc0 + acc1), data, len);
+}
+#endif
+
+/* checksum_sum16
+   Purpose: 16-bit additive checksum (ZFM packets), fastest available version
+   Arguments:
+    sum: Running sum to continue from (0 to start)
+    data: Bytes to add
+    len: Number of bytes
+   Returns: sum plus every byte, modulo 2^16
+*/
+uint16_t checksum_sum16(uint16_t sum, const uint8_t *data, uint32_t len) {
+#ifdef CHECKSUM_HAVE_SIMD
+    return checksum_sum16_simd(sum, data, len);
+#else
+    return checksum_sum16_swar(sum, data, len);
+#endif
+}
+
+/* checksum_crc16_ccitt_soft
+   Purpose: CRC-16/CCITT-FALSE in software, four bits per table lookup
+   Arguments:
+    data: Bytes to checksum
+    len: Number of bytes
+   Returns: The CRC
+*/
+uint16_t checksum_crc16_ccitt_soft(const uint8_t *data, uint32_t len) {
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < len; i++) {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+/* checksum_crc32_soft
+   Purpose: CRC-32 (reflected, as in zlib) in software, four bits per table
+            lookup
+   Arguments:
+    data: Bytes to checksum
+    len: Number of bytes
+   Returns: The CRC
+*/
+uint32_t checksum_crc32_soft(const uint8_t *data, uint32_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < len; i++) {
+        crc = (crc >> 4) ^ table[(crc ^ data[i]) & 0x0F];
+        crc = (crc >> 4) ^ table[(crc ^ (data[i] >> 4)) & 0x0F];
+    }
+    return ~crc;
+}
+
+#ifdef CHECKSUM_HAVE_HW_CRC
+/* crc_unit_run
+   Purpose: Runs bytes through the CRC unit. The unit takes each 32-bit
+            write most significant byte first, so words are byte-swapped
+            into stream order; the last 0-3 bytes go in as byte writes.
+   Arguments:
+    cr: CRC->CR settings (polynomial size, input/output reversal)
+    poly: Polynomial
+    init: Initial value
+    data: Bytes to checksum
+    len: Number of bytes
+   Returns: CRC->DR after the last byte
+*/
+static uint32_t crc_unit_run(uint32_t cr, uint32_t poly, uint32_t init,
+                             const uint8_t *data, uint32_t len) {
+    RCC->AHB1ENR |= RCC_AHB1ENR_CRCEN;
+    CRC->CR = cr;
+    CRC->POL = poly;
+    CRC->INIT = init;
+    CRC->CR = cr | CRC_CR_RESET; // Load INIT into the data register
+
+    for (; len >= 4; len -= 4, data += 4) CRC->DR = __REV(load_word(data));
+    for (; len > 0; len--) *(volatile uint8_t *)&CRC->DR = *data++;
+    return CRC->DR;
+}
+#endif
+
+/* checksum_crc16_ccitt
+   Purpose: CRC-16/CCITT-FALSE, in the CRC unit when there is one
+   Arguments:
+    data: Bytes to checksum
+    len: Number of bytes
+   Returns: The CRC
+*/
+uint16_t checksum_crc16_ccitt(const uint8_t *data, uint32_t len) {
+#ifdef CHECKSUM_HAVE_HW_CRC
+    return crc_unit_run(CRC_CR_POLYSIZE_0, 0x1021, 0xFFFF, data, len) & 0xFFFF;
+#else
+    return checksum_crc16_ccitt_soft(data, len);
+#endif
+}
+
+/* checksum_crc32
+   Purpose: CRC-32 (as in zlib), in the CRC unit when there is one
+   Arguments:
+    data: Bytes to checksum
+    len: Number of bytes
+   Returns: The CRC
+*/
+uint32_t checksum_crc32(const uint8_t *data, uint32_t len) {
+#ifdef CHECKSUM_HAVE_HW_CRC
+    // Default 32-bit polynomial, each input byte and the output bit-reversed
+    return ~crc_unit_run(CRC_CR_REV_IN_0 | CRC_CR_REV_OUT, 0x04C11DB7, 0xFFFFFFFF, data, len);
+#else
+    return checksum_crc32_soft(data, len);
+#endif
+}
@@ -0,0 +1,253 @@
+/* Flash-backed configuration and enrollment store
+ *
+ * Page layout (every field is one 64-bit double word, the flash's smallest
+ * programmable unit):
+ *   page header: CONFIG_PAGE_MAGIC | sequence << 32
+ *   record:      header (magic, key, len, crc16), ceil(len/8) data words,
+ *                commit word
+ *   ...          erased (all 0xFF) after the last record
+ *
+ * A record only counts once its commit word is programmed and its CRC
+ * matches, so a power cut mid-write leaves the previous value in effect.
+ * A double word the cut leaves half programmed can fail its ECC check when
+ * read back; flash_read_dword() reports that instead of letting the NMI hang
+ * the chip, and the scan treats the word as garbage.
+ * Compaction writes the new page's header last, so until then the old page
+ * (and every value in it) stays authoritative.
+ */
+
+#include "config_store.h"
+#include "checksum.h"
+
+#define CONFIG_PAGE_MAGIC 0x584B424CUL      // "LBKX"
+#define CONFIG_RECORD_MAGIC 0xC5
+#define CONFIG_COMMIT 0x5AA5C33C5AA5C33CULL
+#define CONFIG_ERASED 0xFFFFFFFFFFFFFFFFULL
+
+static unsigned int g_active_page;          // 0 or 1, relative to CONFIG_STORE_FIRST_PAGE
+static uint32_t g_sequence;                 // Sequence number of the active page
+static uint32_t g_write_offset;             // Where the next record goes
+static uint16_t g_index[CONFIG_MAX_KEYS];   // Offset of each key's newest record, 0 if unset
+
+static uintptr_t page_addr(unsigned int page) {
+    return FLASH_PAGE_ADDR(CONFIG_STORE_FIRST_PAGE + page);
+}
+
+// A double word whose ECC fails (a program cut short by a power loss) reads
+// as 0, which no page header, record header or commit word matches. Record
+// data is only read once the commit word after it is good.
+static uint64_t read_dword(uintptr_t address) {
+    uint64_t value;
+    if (flash_read_dword(address, &value) != EE14Lib_Err_OK) return 0;
+    return value;
+}
+
+// Bytes taken by a record holding len bytes of data
+static uint32_t record_size(uint8_t len) {
+    return 8 + ((len + 7) & ~7U) + 8;
+}
+
+// CRC-16/CCITT over the key, length and value of a record
+static uint16_t record_crc(uint8_t key, uint8_t len, const uint8_t *value) {
+    uint8_t record[2 + CONFIG_MAX_VALUE] = {key, len};
+    for (int i = 0; i < len; i++) record[2 + i] = value[i];
+    return checksum_crc16_ccitt(record, 2 + len);
+}
+
+// Walk the records of the active page, remembering the newest committed
+// record for each key and where the log ends.
+static void scan_active_page() {
+    uintptr_t base = page_addr(g_active_page);
+    uint32_t offset = 8;
+
+    for (int k = 0; k < CONFIG_MAX_KEYS; k++) g_index[k] = 0;
+
+    while (offset + 16 <= FLASH_PAGE_SIZE) {
+        uint64_t header = read_dword(base + offset);
+        if (header == CONFIG_ERASED) break; // End of the log
+
+        uint8_t magic = header & 0xFF;
+        uint8_t key = (header >> 8) & 0xFF;
+        uint8_t len = (header >> 16) & 0xFF;
+        uint16_t crc = (header >> 32) & 0xFFFF;
+        uint32_t size = record_size(len);
+
+        // A mangled header means we can't tell where the next record starts;
+        // stop here and let the next write compact into a fresh page.
+        if (magic != CONFIG_RECORD_MAGIC || key >= CONFIG_MAX_KEYS ||
+            len > CONFIG_MAX_VALUE || offset + size > FLASH_PAGE_SIZE) {
+            offset = FLASH_PAGE_SIZE;
+            break;
+        }
+
+        const uint8_t *value = (const uint8_t *)(base + offset + 8);
+        if (read_dword(base + offset + size - 8) == CONFIG_COMMIT &&
+            record_crc(key, len, value) == crc) {
+            g_index[key] = offset;
+        }
+        offset += size;
+    }
+    g_write_offset = offset;
+}
+
+// Program one record at the end of the given page.
+static EE14Lib_Err append_record(unsigned int page, uint32_t *offset, uint8_t key,
+                                 const uint8_t *value, uint8_t len) {
+    uintptr_t address = page_addr(page) + *offset;
+    uint64_t header = CONFIG_RECORD_MAGIC | ((uint64_t)key << 8) | ((uint64_t)len << 16)
+                      | (0xFFULL << 24) | ((uint64_t)record_crc(key, len, value) << 32)
+                      | (0xFFFFULL << 48);
+    EE14Lib_Err err = flash_program_dword(address, header);
+    address += 8;
+
+    for (int i = 0; i < len && err == EE14Lib_Err_OK; i += 8) {
+        uint64_t word = CONFIG_ERASED;
+        for (int b = 0; b < 8 && i + b < len; b++) {
+            word &= ~(0xFFULL << (8 * b));
+            word |= (uint64_t)value[i + b] << (8 * b);
+        }
+        err = flash_program_dword(address, word);
+        address += 8;
+    }
+
+    // Commit word goes last; until it is there the record doesn't exist
+    if (err == EE14Lib_Err_OK)
+        err = flash_program_dword(address, CONFIG_COMMIT);
+    *offset += record_size(len);
+    return err;
+}
+
+// Copy the newest value of every key into the other page, then make it the
+// active page by writing its header.
+static EE14Lib_Err compact() {
+    unsigned int dest = g_active_page ^ 1;
+    uintptr_t src_base = page_addr(g_active_page);
+    uint32_t offset = 8;
+    uint16_t new_index[CONFIG_MAX_KEYS];
+
+    EE14Lib_Err err = flash_erase_page(CONFIG_STORE_FIRST_PAGE + dest);
+    for (int k = 0; k < CONFIG_MAX_KEYS && err == EE14Lib_Err_OK; k++) {
+        new_index[k] = 0;
+        if (!g_index[k]) continue;
+        uint8_t len = (read_dword(src_base + g_index[k]) >> 16) & 0xFF;
+        new_index[k] = offset;
+        err = append_record(dest, &offset, k,
+                            (const uint8_t *)(src_base + g_index[k] + 8), len);
+    }
+    if (err != EE14Lib_Err_OK) return err;
+
+    err = flash_program_dword(page_addr(dest),
+                              CONFIG_PAGE_MAGIC | ((uint64_t)(g_sequence + 1) << 32));
+    if (err != EE14Lib_Err_OK) return err;
+
+    g_active_page = dest;
+    g_sequence++;
+    g_write_offset = offset;
+    for (int k = 0; k < CONFIG_MAX_KEYS; k++) g_index[k] = new_index[k];
+    return EE14Lib_Err_OK;
+}
+
+// Find the active page and index its records. Formats the store if neither
+// page holds a valid header (first boot).
+// Returns EE14Lib_ERR_FLASH if formatting failed, otherwise EE14Lib_Err_OK.
+EE14Lib_Err config_store_init()
+{
+    bool valid[CONFIG_STORE_PAGES];
+    uint32_t sequence[CONFIG_STORE_PAGES];
+
+    for (unsigned int p = 0; p < CONFIG_STORE_PAGES; p++) {
+        uint64_t header = read_dword(page_addr(p));
+        valid[p] = (uint32_t)header == CONFIG_PAGE_MAGIC;
+        sequence[p] = header >> 32;
+    }
+
+    if (!valid[0] && !valid[1]) {
+        EE14Lib_Err err = flash_erase_page(CONFIG_STORE_FIRST_PAGE);
+        if (err == EE14Lib_Err_OK)
+            err = flash_program_dword(page_addr(0), CONFIG_PAGE_MAGIC | (1ULL << 32));
+        if (err != EE14Lib_Err_OK) return err;
+        valid[0] = true;
+        sequence[0] = 1;
+    }
+
+    // Both valid means a compaction finished but the old page wasn't reused
+    // yet; the newer sequence number wins (compared so that wraparound works).
+    if (valid[0] && valid[1])
+        g_active_page = (int32_t)(sequence[1] - sequence[0]) > 0 ? 1 : 0;
+    else
+        g_active_page = valid[0] ? 0 : 1;
+    g_sequence = sequence[g_active_page];
+
+    scan_active_page();
+    return EE14Lib_Err_OK;
+}
+
+// Read a value.
+//   key: Key to look up, below CONFIG_MAX_KEYS
+//   value: Buffer for the value
+//   max_len: Size of the buffer; longer values are truncated
+// Returns the number of bytes copied, or -1 if the key has never been set.
+int config_get(uint8_t key, void *value, int max_len)
+{
+    if (key >= CONFIG_MAX_KEYS || !g_index[key]) return -1;
+
+    uintptr_t address = page_addr(g_active_page) + g_index[key];
+    int len = (read_dword(address) >> 16) & 0xFF;
+    const uint8_t *src = (const uint8_t *)(address + 8);
+    uint8_t *dst = (uint8_t *)value;
+
+    if (len > max_len) len = max_len;
+    for (int i = 0; i < len; i++) dst[i] = src[i];
+    return len;
+}
+
+// Store a value, compacting into the other page first if this one is full.
+// Writing the value a key already holds is a no-op, to save flash wear.
+//   key: Key to set, below CONFIG_MAX_KEYS
+//   value: Data to store
+//   len: Length of data, at most CONFIG_MAX_VALUE
+// Returns EE14Lib_ERR_INVALID_CONFIG for a bad key/length or if the store is
+// full even after compaction, EE14Lib_ERR_FLASH on a flash error, otherwise
+// EE14Lib_Err_OK.
+EE14Lib_Err config_set(uint8_t key, const void *value, uint8_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)value;
+
+    if (key >= CONFIG_MAX_KEYS || len > CONFIG_MAX_VALUE) {
+        return EE14Lib_ERR_INVALID_CONFIG;
+    }
+
+    if (g_index[key]) {
+        uintptr_t address = page_addr(g_active_page) + g_index[key];
+        const uint8_t *old = (const uint8_t *)(address + 8);
+        bool same = ((read_dword(address) >> 16) & 0xFF) == len;
+        for (int i = 0; same && i < len; i++) same = old[i] == bytes[i];
+        if (same) return EE14Lib_Err_OK;
+    }
+
+    if (g_write_offset + record_size(len) > FLASH_PAGE_SIZE) {
+        EE14Lib_Err err = compact();
+        if (err != EE14Lib_Err_OK) return err;
+        if (g_write_offset + record_size(len) > FLASH_PAGE_SIZE)
+            return EE14Lib_ERR_INVALID_CONFIG;
+    }
+
+    uint32_t offset = g_write_offset;
+    EE14Lib_Err err = append_record(g_active_page, &g_write_offset, key, bytes, len);
+    if (err == EE14Lib_Err_OK) g_index[key] = offset;
+    return err;
+}
+
+// Read a 32-bit value, or default_value if the key has not been set.
+uint32_t config_get_u32(uint8_t key, uint32_t default_value)
+{
+    uint32_t value;
+    if (config_get(key, &value, sizeof(value)) != sizeof(value)) return default_value;
+    return value;
+}
+
+// Store a 32-bit value.
+EE14Lib_Err config_set_u32(uint8_t key, uint32_t value)
+{
+    return config_set(key, &value, sizeof(value));
+}
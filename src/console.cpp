@@ -0,0 +1,141 @@
+/* Commands typed on the serial monitor (see console.h) */
+
+#include "console.h"
+#include <string.h>
+
+static char g_line[CONSOLE_MAX_LINE + 1];
+static uint8_t g_line_len;
+static bool g_line_overflow; // Too long; ignored up to the end of the line
+
+/* console_print
+   Purpose: Writes a NUL-terminated string to the serial monitor
+   Arguments:
+    text: String to write
+   Returns: None
+*/
+static void console_print(const char *text) {
+    serial_write(USART2, text, strlen(text));
+}
+
+/* console_help
+   Purpose: Lists the usage of every command
+   Arguments:
+    commands: Command table
+    count: Entries in the table
+   Returns: None
+*/
+static void console_help(const console_command *commands, int count) {
+    for (int i = 0; i < count; i++) {
+        console_print(commands[i].usage);
+        console_print("\r\n");
+    }
+}
+
+/* console_run
+   Purpose: Splits a line into words and runs the command it names
+   Arguments:
+    line: The line, without its end-of-line character; modified in place
+    commands: Command table
+    count: Entries in the table
+   Returns: None
+*/
+static void console_run(char *line, const console_command *commands, int count) {
+    char *argv[CONSOLE_MAX_ARGS];
+    int argc = 0;
+
+    for (char *p = line; *p; ) {
+        while (*p == ' ') *p++ = '\0';
+        if (!*p) break;
+        if (argc == CONSOLE_MAX_ARGS) {
+            argc++; // Too many words
+            break;
+        }
+        argv[argc++] = p;
+        while (*p && *p != ' ') p++;
+    }
+    if (argc == 0) return;
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(argv[0], commands[i].name) != 0) continue;
+        if (argc - 1 != commands[i].args) {
+            console_print("usage: ");
+            console_print(commands[i].usage);
+            console_print("\r\n");
+            return;
+        }
+        commands[i].run(argv);
+        return;
+    }
+    console_help(commands, count);
+}
+
+/* console_init
+   Purpose: Starts buffering serial monitor input; call after the serial
+            ports are up
+   Arguments: None
+   Returns: None
+*/
+void console_init() {
+    g_line_len = 0;
+    g_line_overflow = false;
+    serial_rx_interrupt_enable(USART2);
+}
+
+/* console_poll
+   Purpose: Takes whatever has been typed since the last call and runs each
+            completed line. Doesn't wait for input.
+   Arguments:
+    commands: Command table; a line matching no command prints every usage
+    count: Entries in the table
+   Returns: None
+*/
+void console_poll(const console_command *commands, int count) {
+    int c;
+    while ((c = serial_read_timeout(USART2, 0)) >= 0) {
+        if (c == '\r' || c == '\n') {
+            if (g_line_overflow) {
+                console_print("line too long\r\n");
+            } else {
+                g_line[g_line_len] = '\0';
+                console_run(g_line, commands, count);
+            }
+            g_line_len = 0;
+            g_line_overflow = false;
+        } else if (c == '\b' || c == 0x7F) {
+            if (g_line_len) g_line_len--;
+        } else if (g_line_len < CONSOLE_MAX_LINE) {
+            g_line[g_line_len++] = (char)c;
+        } else {
+            g_line_overflow = true;
+        }
+    }
+}
+
+/* console_parse_u32
+   Purpose: Reads a number argument, decimal or 0x-prefixed hex
+   Arguments:
+    text: The argument
+    value: Set to the number on success
+   Returns: false if text isn't a number that fits in 32 bits
+*/
+bool console_parse_u32(const char *text, uint32_t *value) {
+    uint32_t base = 10;
+    uint64_t n = 0;
+
+    if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        base = 16;
+        text += 2;
+    }
+    if (!*text) return false;
+    for (; *text; text++) {
+        uint32_t digit;
+        if (*text >= '0' && *text <= '9') digit = *text - '0';
+        else if (base == 16 && *text >= 'a' && *text <= 'f') digit = *text - 'a' + 10;
+        else if (base == 16 && *text >= 'A' && *text <= 'F') digit = *text - 'A' + 10;
+        else return false;
+        n = n * base + digit;
+        if (n > 0xFFFFFFFFULL) return false;
+    }
+    *value = (uint32_t)n;
+    return true;
+}
@@ -0,0 +1,720 @@
+/* Fingerprint sensor packet protocol and link layer
+ *
+ * Encodes command packets, parses and validates ACK packets, and recovers
+ * from a noisy USART1 link: hunts for the 0xEF01 header after garbage,
+ * detects missing/late ACKs, re-issues idempotent commands and logs back in
+ * with VERIFYPASSWORD if the sensor resets underneath us. Matching tries
+ * the most recently matched pages before searching the whole library.
+ */
+
+#include "fingerprint.h"
+#include "trace.h"
+#include "checksum.h"
+#ifdef FINGERPRINT_LINK_SIM
+#include "sensor_sim.h"
+#endif
+
+fingerprint_link_stats g_fingerprint_stats;
+fingerprint_match_stats g_fingerprint_match_stats;
+
+// Parser states, in the order the packet fields arrive
+enum {
+    PARSE_HUNT_H, // Waiting for 0xEF
+    PARSE_HUNT_L, // Waiting for 0x01
+    PARSE_ADDR,   // Four address bytes
+    PARSE_TYPE,
+    PARSE_LEN_H,
+    PARSE_LEN_L,
+    PARSE_BODY    // Payload followed by two checksum bytes
+};
+
+static uint32_t g_password = 0;
+static bool g_needs_login = false;
+static int g_consecutive_timeouts = 0;
+static uint32_t g_attempt_sent_us; // When command_send() last sent a command
+
+// Two missing ACKs in a row usually means the sensor browned out and rebooted
+#define FINGERPRINT_RESET_AFTER_TIMEOUTS 2
+
+// Give up on a reply after this many bytes that could not be framed
+#define FINGERPRINT_MAX_GARBAGE 64
+
+// Recently matched pages, highest score first
+typedef struct {
+    uint16_t page_id;
+    uint32_t score;   // Decaying match count, in FINGERPRINT_SCORE_UNITs
+    uint32_t full_us; // What the full SEARCH took when it last found this page
+} recent_page;
+
+#define FINGERPRINT_SCORE_UNIT 256 // Fixed point, so halving keeps some precision
+
+// Pages scored: the first g_recent_size are probed, the rest are candidates
+// building up a score. A newcomer takes the last candidate's place, so one
+// visit by an occasional user can't push out a regular.
+#define FINGERPRINT_RECENT_TRACKED (2 * FINGERPRINT_RECENT_SIZE)
+
+static recent_page g_recent[FINGERPRINT_RECENT_TRACKED];
+static uint8_t g_recent_count = 0;
+static uint8_t g_recent_size = FINGERPRINT_RECENT_SIZE;
+static uint32_t g_recent_total;     // Decaying count of all decisions, same units
+static uint32_t g_probe_us;         // Running average cost of a one-page SEARCH
+static uint32_t g_recent_decisions; // Since the last decay
+
+
+// The link backend is picked at build time so the firmware talks to USART1
+// with no per-byte checks: FINGERPRINT_LINK_SIM wires the link to the
+// simulated sensor (sensor_sim.h), FINGERPRINT_REPLAY to a captured trace
+// (trace.h). Capture (FINGERPRINT_TRACE) records whichever is in use.
+#if defined(FINGERPRINT_LINK_SIM) && defined(FINGERPRINT_REPLAY)
+#error "FINGERPRINT_LINK_SIM and FINGERPRINT_REPLAY are mutually exclusive"
+#endif
+
+/* link_now_us
+   Purpose: Clock for latency statistics: simulated time when talking to the
+            simulated sensor, otherwise the cycle-counter clock
+   Arguments: None
+   Returns: Microseconds
+*/
+static uint32_t link_now_us() {
+#ifdef FINGERPRINT_LINK_SIM
+    return sensor_sim_now_us();
+#else
+    return trace_now_us();
+#endif
+}
+
+/* link_write
+   Purpose: Sends bytes to the sensor (or the simulated sensor, or checks them
+            against a trace being replayed), recording them if capture is on
+   Arguments:
+    data: Bytes to send
+    len: Number of bytes
+   Returns: None
+*/
+static void link_write(const uint8_t *data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+#ifdef FINGERPRINT_TRACE
+        trace_record(TRACE_TX, data[i], link_now_us());
+#endif
+#if defined(FINGERPRINT_LINK_SIM)
+        sensor_sim_tx(data[i]);
+#elif defined(FINGERPRINT_REPLAY)
+        trace_replay_tx(data[i]);
+#else
+        serial_write(USART1, (const char *)&data[i], 1);
+#endif
+    }
+}
+
+/* link_read
+   Purpose: Receives one byte from the sensor (or the simulated sensor, or the
+            trace being replayed), recording it if capture is on
+   Arguments:
+    timeout_us: How long to wait
+   Returns: The byte, or -1 on timeout
+*/
+static int link_read(uint32_t timeout_us) {
+#if defined(FINGERPRINT_LINK_SIM)
+    int c = sensor_sim_rx(timeout_us);
+#elif defined(FINGERPRINT_REPLAY)
+    int c = trace_replay_rx(timeout_us);
+#else
+    int c = serial_read_timeout(USART1, timeout_us);
+#endif
+#ifdef FINGERPRINT_TRACE
+    if (c >= 0) trace_record(TRACE_RX, (uint8_t)c, link_now_us());
+#endif
+    return c;
+}
+
+/* link_flush
+   Purpose: Drops received bytes nobody is waiting for (still recording them,
+            so a replay sees the same stale bytes)
+   Arguments: None
+   Returns: Number of bytes dropped
+*/
+static int link_flush() {
+#if defined(FINGERPRINT_LINK_SIM)
+    return sensor_sim_flush();
+#elif defined(FINGERPRINT_REPLAY)
+    return trace_replay_flush();
+#elif defined(FINGERPRINT_TRACE)
+    int n = 0;
+    while (link_read(0) >= 0) n++;
+    return n;
+#else
+    return serial_flush_rx(USART1);
+#endif
+}
+
+
+
+/* fingerprint_parser_reset
+   Purpose: Puts parser back into the header-hunting state
+   Arguments:
+    parser: Parser to reset
+   Returns: None
+*/
+void fingerprint_parser_reset(fingerprint_parser *parser) {
+    parser->state = PARSE_HUNT_H;
+    parser->idx = 0;
+    parser->sum = 0;
+    parser->rx_checksum = 0;
+}
+
+/* parser_resync
+   Purpose: Drops the partial packet and starts hunting for a header again.
+            The offending byte may itself be the start of the next header.
+   Arguments:
+    parser: Parser to resync
+    byte: Byte that broke framing
+    stats: Counters to charge the resync to
+   Returns: FINGERPRINT_PARSE_ERROR
+*/
+static int parser_resync(fingerprint_parser *parser, uint8_t byte, fingerprint_link_stats *stats) {
+    stats->resyncs++;
+    fingerprint_parser_reset(parser);
+    if (byte == FINGERPRINT_START_CODE_H) parser->state = PARSE_HUNT_L;
+    return FINGERPRINT_PARSE_ERROR;
+}
+
+/* fingerprint_parser_feed
+   Purpose: Advances parser by one received byte, validating the header and
+            length as they arrive and the checksum once the packet is in
+   Arguments:
+    parser: Parser state
+    byte: Next byte from the sensor
+    stats: Counters for checksum failures and resyncs; the link layer passes
+     &g_fingerprint_stats, the simulated sensor its own
+   Returns: FINGERPRINT_PARSE_COMPLETE once parser->packet holds a valid
+    packet, FINGERPRINT_PARSE_ERROR if the byte was discarded or broke framing,
+    otherwise FINGERPRINT_PARSE_INCOMPLETE
+*/
+int fingerprint_parser_feed(fingerprint_parser *parser, uint8_t byte, fingerprint_link_stats *stats) {
+    fingerprint_packet *pkt = &parser->packet;
+
+    switch (parser->state) {
+    case PARSE_HUNT_H:
+        if (byte != FINGERPRINT_START_CODE_H) return FINGERPRINT_PARSE_ERROR;
+        parser->state = PARSE_HUNT_L;
+        break;
+
+    case PARSE_HUNT_L:
+        if (byte != FINGERPRINT_START_CODE_L) return parser_resync(parser, byte, stats);
+        parser->state = PARSE_ADDR;
+        parser->idx = 0;
+        break;
+
+    case PARSE_ADDR:
+        if (byte != 0xFF) return parser_resync(parser, byte, stats);
+        if (++parser->idx == 4) parser->state = PARSE_TYPE;
+        break;
+
+    case PARSE_TYPE:
+        pkt->type = byte;
+        parser->sum = byte;
+        parser->state = PARSE_LEN_H;
+        break;
+
+    case PARSE_LEN_H:
+        pkt->length = byte << 8;
+        parser->sum += byte;
+        parser->state = PARSE_LEN_L;
+        break;
+
+    case PARSE_LEN_L:
+        pkt->length |= byte;
+        parser->sum += byte;
+        // Length on the wire counts the checksum; it must leave room for at
+        // least the checksum and the payload must fit in our buffer.
+        if (pkt->length < 2 || pkt->length - 2 > FINGERPRINT_MAX_PAYLOAD)
+            return parser_resync(parser, byte, stats);
+        pkt->length -= 2;
+        parser->idx = 0;
+        parser->state = PARSE_BODY;
+        break;
+
+    case PARSE_BODY:
+        if (parser->idx < pkt->length) {
+            pkt->data[parser->idx] = byte;
+        } else if (parser->idx == pkt->length) {
+            parser->rx_checksum = byte << 8;
+        } else {
+            parser->rx_checksum |= byte;
+            // Header bytes were summed on the way in; the payload goes in one pass
+            uint16_t sum = checksum_sum16(parser->sum, pkt->data, pkt->length);
+            uint16_t rx_checksum = parser->rx_checksum;
+            fingerprint_parser_reset(parser);
+            if (sum != rx_checksum) {
+                stats->checksum_failures++;
+                stats->resyncs++;
+                return FINGERPRINT_PARSE_ERROR;
+            }
+            return FINGERPRINT_PARSE_COMPLETE;
+        }
+        parser->idx++;
+        break;
+    }
+    return FINGERPRINT_PARSE_INCOMPLETE;
+}
+
+/* fingerprint_encode_packet
+   Purpose: Builds a packet of any type (header, length, payload, checksum)
+   Arguments:
+    packet: Output buffer, at least 11 + payload_len bytes
+    type: Packet type, e.g. FINGERPRINT_COMMANDPACKET or FINGERPRINT_ACKPACKET
+    payload: Payload without the checksum
+    payload_len: Length of payload
+   Returns: Number of bytes written to packet
+*/
+uint16_t fingerprint_encode_packet(uint8_t *packet, uint8_t type, const uint8_t *payload, uint16_t payload_len) {
+    uint16_t idx = 0;
+    uint16_t length = payload_len + 2; // Length on the wire counts the checksum
+
+    packet[idx++] = FINGERPRINT_START_CODE_H;
+    packet[idx++] = FINGERPRINT_START_CODE_L;
+    for (int i = 0; i < 4; i++) packet[idx++] = 0xFF;
+    packet[idx++] = type;
+    packet[idx++] = (length >> 8) & 0xFF;
+    packet[idx++] = length & 0xFF;
+
+    for (uint16_t i = 0; i < payload_len; i++) packet[idx++] = payload[i];
+
+    uint16_t checksum = checksum_sum16(0, packet + 6, idx - 6); // Type, length and payload
+    packet[idx++] = (checksum >> 8) & 0xFF;
+    packet[idx++] = checksum & 0xFF;
+
+    return idx;
+}
+
+/* fingerprint_encode_command
+   Purpose: Builds a command packet
+   Arguments:
+    packet: Output buffer, at least 12 + args_len bytes
+    command: Command byte, see documentation
+    args: Optional arguments, see documentation per command
+    args_len: Length of arguments, see documentation per command
+   Returns: Number of bytes written to packet
+*/
+uint16_t fingerprint_encode_command(uint8_t *packet, uint8_t command, const uint8_t *args, uint8_t args_len) {
+    uint8_t payload[FINGERPRINT_MAX_PAYLOAD];
+
+    if (args_len > FINGERPRINT_MAX_ARGS) args_len = FINGERPRINT_MAX_ARGS;
+    payload[0] = command;
+    for (uint8_t i = 0; i < args_len; i++) payload[1 + i] = args[i];
+    return fingerprint_encode_packet(packet, FINGERPRINT_COMMANDPACKET, payload, 1 + args_len);
+}
+
+/* send_fingerprint_command
+   Purpose: Sends command packet to sensor without waiting for the reply
+   Arguments:
+    command: Command byte, see documentation
+    args: Optional arguments, see documentation per command
+    args_len: Length of arguments, see documentation per command
+   Returns: None--use fingerprint_command() to check the sensor's answer
+*/
+void send_fingerprint_command(uint8_t command, uint8_t *args, uint8_t args_len) {
+    uint8_t packet[FINGERPRINT_MAX_PACKET];
+    static_assert(sizeof(packet) >= 12 + FINGERPRINT_MAX_ARGS,
+                  "command packet buffer must hold the longest command fingerprint_encode_command() builds");
+    uint16_t len = fingerprint_encode_command(packet, command, args, args_len);
+    link_write(packet, len);
+}
+
+/* fingerprint_read_reply
+   Purpose: Receives one ACK packet, skipping garbage and corrupted packets
+   Arguments:
+    reply: Filled in with the validated packet
+    timeout_us: How long to wait for the reply to start
+   Returns: Confirmation code of the ACK, or FINGERPRINT_LINK_TIMEOUT if no
+    valid ACK arrived (nothing received, packet stalled, or only garbage)
+*/
+int fingerprint_read_reply(fingerprint_packet *reply, uint32_t timeout_us) {
+    fingerprint_parser parser;
+    int garbage = 0;
+    bool hunting = false; // Already counted a resync for this run of garbage
+
+    fingerprint_parser_reset(&parser);
+    while (garbage < FINGERPRINT_MAX_GARBAGE) {
+        bool mid_packet = parser.state != PARSE_HUNT_H;
+        int c = link_read(mid_packet ? FINGERPRINT_BYTE_TIMEOUT_US : timeout_us);
+        if (c < 0) {
+            // A packet that stops halfway lost bytes on the wire
+            if (mid_packet) g_fingerprint_stats.resyncs++;
+            return FINGERPRINT_LINK_TIMEOUT;
+        }
+
+        if (c == FINGERPRINT_HANDSHAKE && !mid_packet) g_needs_login = true;
+
+        int r = fingerprint_parser_feed(&parser, (uint8_t)c, &g_fingerprint_stats);
+        if (r == FINGERPRINT_PARSE_ERROR) {
+            garbage++;
+            if (!mid_packet && !hunting) g_fingerprint_stats.resyncs++;
+            hunting = true;
+        } else if (r == FINGERPRINT_PARSE_COMPLETE) {
+            hunting = false;
+            if (parser.packet.type != FINGERPRINT_ACKPACKET || parser.packet.length == 0) {
+                garbage++;
+                continue;
+            }
+            *reply = parser.packet;
+            return reply->data[0];
+        }
+    }
+    return FINGERPRINT_LINK_TIMEOUT;
+}
+
+/* fingerprint_is_idempotent
+   Purpose: Whether re-sending a command is harmless if its ACK was lost
+   Arguments:
+    command: Command byte
+   Returns: true for commands that can be retried
+*/
+static bool fingerprint_is_idempotent(uint8_t command) {
+    switch (command) {
+    case FINGERPRINT_GETIMAGE:
+    case FINGERPRINT_IMAGE2TZ:
+    case FINGERPRINT_MATCH:
+    case FINGERPRINT_SEARCH:
+    case FINGERPRINT_LOADCHAR:
+    case FINGERPRINT_VERIFYPASSWORD:
+    case FINGERPRINT_TEMPLATECOUNT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* fingerprint_relogin
+   Purpose: Re-runs VERIFYPASSWORD after the sensor appears to have reset
+   Arguments: None
+   Returns: None
+*/
+static void fingerprint_relogin() {
+    uint8_t args[4] = {
+        (uint8_t)(g_password >> 24), (uint8_t)(g_password >> 16),
+        (uint8_t)(g_password >> 8), (uint8_t)g_password
+    };
+    fingerprint_packet reply;
+
+    g_needs_login = false;
+    g_fingerprint_stats.reverifies++;
+    fingerprint_command(FINGERPRINT_VERIFYPASSWORD, args, 4, &reply);
+}
+
+/* command_send
+   Purpose: Sends one attempt of a command, logging in again first if the
+            sensor has reset
+   Arguments:
+    command: Command byte, see documentation
+    args: Optional arguments, see documentation per command
+    args_len: Length of arguments, see documentation per command
+   Returns: None
+*/
+static void command_send(uint8_t command, uint8_t *args, uint8_t args_len) {
+    if (g_needs_login && command != FINGERPRINT_VERIFYPASSWORD) fingerprint_relogin();
+
+    // Late ACKs from an earlier attempt would be mistaken for this reply
+    g_fingerprint_stats.stale_bytes += link_flush();
+    g_attempt_sent_us = link_now_us();
+    send_fingerprint_command(command, args, args_len);
+}
+
+/* fingerprint_command_start
+   Purpose: Sends a command without waiting for its ACK, so other work can
+            run while the sensor is busy. Must be followed by
+            fingerprint_command_finish() with the same arguments before
+            any other command.
+   Arguments:
+    command: Command byte, see documentation
+    args: Optional arguments, see documentation per command
+    args_len: Length of arguments, see documentation per command
+   Returns: None
+*/
+void fingerprint_command_start(uint8_t command, uint8_t *args, uint8_t args_len) {
+    command_send(command, args, args_len);
+}
+
+/* fingerprint_command_finish
+   Purpose: Waits for the ACK of a command sent by fingerprint_command_start(),
+            re-sending idempotent commands when the ACK is missing or the
+            sensor saw a corrupted packet
+   Arguments:
+    command: Command byte, as given to fingerprint_command_start()
+    args: Arguments, as given to fingerprint_command_start()
+    args_len: Length of arguments
+    reply: Filled in with the ACK packet on success
+   Returns: Confirmation code from the sensor, or FINGERPRINT_LINK_TIMEOUT
+*/
+int fingerprint_command_finish(uint8_t command, uint8_t *args, uint8_t args_len, fingerprint_packet *reply) {
+    int attempts = fingerprint_is_idempotent(command) ? 1 + FINGERPRINT_MAX_RETRIES : 1;
+    int code = FINGERPRINT_LINK_TIMEOUT;
+    uint32_t failed_since_us = 0; // When the first failed attempt went out
+
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        if (attempt > 0) {
+            if (attempt == 1) failed_since_us = g_attempt_sent_us;
+            g_fingerprint_stats.retries++;
+            command_send(command, args, args_len);
+        }
+        code = fingerprint_read_reply(reply, FINGERPRINT_ACK_TIMEOUT_US);
+
+        if (code == FINGERPRINT_LINK_TIMEOUT) {
+            g_fingerprint_stats.timeouts++;
+            if (++g_consecutive_timeouts >= FINGERPRINT_RESET_AFTER_TIMEOUTS)
+                g_needs_login = true;
+            continue;
+        }
+        g_consecutive_timeouts = 0;
+
+        if (code == FINGERPRINT_NEEDPASSWORD) {
+            g_needs_login = true;
+            continue;
+        }
+        if (code == FINGERPRINT_PACKETRECIEVEERR) continue; // Sensor got a corrupted packet
+        if (attempt > 0) {
+            g_fingerprint_stats.recoveries++;
+            g_fingerprint_stats.recovery_us += link_now_us() - failed_since_us;
+        }
+        return code;
+    }
+    return code;
+}
+
+/* fingerprint_command
+   Purpose: Sends a command and waits for its ACK, retrying idempotent
+            commands when the ACK is missing or the sensor saw a corrupted packet
+   Arguments:
+    command: Command byte, see documentation
+    args: Optional arguments, see documentation per command
+    args_len: Length of arguments, see documentation per command
+    reply: Filled in with the ACK packet on success
+   Returns: Confirmation code from the sensor, or FINGERPRINT_LINK_TIMEOUT
+*/
+int fingerprint_command(uint8_t command, uint8_t *args, uint8_t args_len, fingerprint_packet *reply) {
+    fingerprint_command_start(command, args, args_len);
+    return fingerprint_command_finish(command, args, args_len, reply);
+}
+
+/* fingerprint_link_init
+   Purpose: Starts buffering USART1 replies in its receive ring, logs in to
+            the sensor and remembers the password so the link layer can log
+            in again after a sensor reset
+   Arguments:
+    password: Sensor password (0 unless it has been changed)
+   Returns: Confirmation code of VERIFYPASSWORD, or FINGERPRINT_LINK_TIMEOUT
+*/
+int fingerprint_link_init(uint32_t password) {
+    uint8_t args[4] = {
+        (uint8_t)(password >> 24), (uint8_t)(password >> 16),
+        (uint8_t)(password >> 8), (uint8_t)password
+    };
+    fingerprint_packet reply;
+
+    g_password = password;
+    g_needs_login = false;
+    // Replies keep arriving while the caller is busy elsewhere, e.g. printing
+    // to the serial monitor during a pipelined capture (scan.h); the bare
+    // receive register would overrun on the second byte
+#if !defined(FINGERPRINT_LINK_SIM) && !defined(FINGERPRINT_REPLAY)
+    serial_rx_interrupt_enable(USART1);
+#endif
+    return fingerprint_command(FINGERPRINT_VERIFYPASSWORD, args, 4, &reply);
+}
+
+/* search_pages
+   Purpose: Searches part of the sensor library for a template
+   Arguments:
+    buffer: CHARBUFFER1 or CHARBUFFER2, holding the template
+    start: First page to search
+    count: Number of pages
+    page_id: Set to the matching page ID on success
+   Returns: true if a page in the range matched
+*/
+static bool search_pages(uint8_t buffer, uint16_t start, uint16_t count, uint16_t *page_id) {
+    uint8_t args[5] = {buffer, (uint8_t)(start >> 8), (uint8_t)start,
+                       (uint8_t)(count >> 8), (uint8_t)count};
+    fingerprint_packet reply;
+
+    if (fingerprint_command(FINGERPRINT_SEARCH, args, 5, &reply) != FINGERPRINT_OK
+        || reply.length < 3)
+        return false;
+    *page_id = (reply.data[1] << 8) | reply.data[2];
+    return true;
+}
+
+/* recent_search
+   Purpose: Fast path: a one-page SEARCH of the recent pages, best first. A
+            probe of entry i costs g_probe_us whenever it is reached, i.e.
+            unless an earlier one matched, and saves its full_us when it hits,
+            so probing the first n entries saves on average (in score units)
+              sum over i < n of score_i * full_us_i - g_probe_us * remaining_i
+            where remaining_i is the total less the scores of earlier entries.
+            Probes the n that saves the most, which may be none. A marginal
+            first entry is still worth it if the ones after it pay off, but
+            the run has to save a quarter of a probe per decision: scores
+            that only just break even are mostly estimation noise.
+   Arguments:
+    buffer: CHARBUFFER1 or CHARBUFFER2, holding the template
+    page_id: Set to the matching page ID on success
+    tried: Set to whether any page was searched
+   Returns: true if one of the recent pages matched
+*/
+static bool recent_search(uint8_t buffer, uint16_t *page_id, bool *tried) {
+    int count = g_recent_count < g_recent_size ? g_recent_count : g_recent_size;
+    uint32_t remaining = g_recent_total;
+    int64_t saving = 0, best_saving = (int64_t)g_probe_us * g_recent_total / 4;
+    int probes = 0;
+
+    for (int i = 0; i < count; i++) {
+        const recent_page *r = &g_recent[i];
+        saving += (int64_t)r->score * r->full_us - (int64_t)g_probe_us * remaining;
+        if (saving > best_saving) {
+            best_saving = saving;
+            probes = i + 1;
+        }
+        remaining = remaining > r->score ? remaining - r->score : 0;
+    }
+
+    *tried = false;
+    for (int i = 0; i < probes; i++) {
+        const recent_page *r = &g_recent[i];
+        uint32_t start_us = link_now_us();
+        bool found = search_pages(buffer, r->page_id, 1, page_id);
+        uint32_t probe_us = link_now_us() - start_us;
+        if (g_probe_us == 0) g_probe_us = probe_us; // First measurement
+        else g_probe_us = g_probe_us - g_probe_us / 8 + probe_us / 8;
+
+        *tried = true;
+        if (found) return true;
+    }
+    return false;
+}
+
+/* recent_update
+   Purpose: Scores the outcome of a decision: ages every score now and then,
+            credits the matched page (adding it in place of the last candidate
+            if it is new) and keeps the list sorted by score
+   Arguments:
+    matched: Whether the finger was found
+    page_id: Page that matched
+    full_us: Time of the full SEARCH that found it, or 0 if the fast path did
+   Returns: None
+*/
+static void recent_update(bool matched, uint16_t page_id, uint32_t full_us) {
+    if (g_recent_size == 0) return;
+
+    if (++g_recent_decisions >= FINGERPRINT_RECENT_DECAY) {
+        g_recent_decisions = 0;
+        g_recent_total /= 2;
+        for (int i = 0; i < g_recent_count; i++) g_recent[i].score /= 2;
+    }
+    g_recent_total += FINGERPRINT_SCORE_UNIT;
+    if (!matched) return;
+
+    int i = 0;
+    while (i < g_recent_count && g_recent[i].page_id != page_id) i++;
+    if (i == g_recent_count) {
+        if (g_recent_count < FINGERPRINT_RECENT_TRACKED) g_recent_count++;
+        i = g_recent_count - 1; // Replaces the last candidate when full
+        g_recent[i].page_id = page_id;
+        g_recent[i].score = 0;
+    }
+    g_recent[i].score += FINGERPRINT_SCORE_UNIT;
+    if (full_us) g_recent[i].full_us = full_us;
+
+    for (; i > 0 && g_recent[i].score > g_recent[i - 1].score; i--) {
+        recent_page t = g_recent[i];
+        g_recent[i] = g_recent[i - 1];
+        g_recent[i - 1] = t;
+    }
+}
+
+/* fingerprint_recent_configure
+   Purpose: Sets how many recently matched pages the fast path keeps, and
+            forgets the current ones and their statistics
+   Arguments:
+    size: 0 (always do the full search) to FINGERPRINT_RECENT_SIZE
+   Returns: None
+*/
+void fingerprint_recent_configure(uint8_t size) {
+    g_recent_size = size > FINGERPRINT_RECENT_SIZE ? FINGERPRINT_RECENT_SIZE : size;
+    g_recent_count = 0;
+    g_recent_total = 0;
+    g_recent_decisions = 0;
+    g_probe_us = 0;
+}
+
+/* fingerprint_now_us
+   Purpose: The clock match latencies are measured with (simulated time when
+            talking to the simulated sensor)
+   Arguments: None
+   Returns: Microseconds
+*/
+uint32_t fingerprint_now_us() {
+    return link_now_us();
+}
+
+/* fingerprint_identify
+   Purpose: Looks up a template already extracted into a CharBuffer: first
+            at pages that matched recently, then the whole library
+   Arguments:
+    buffer: CHARBUFFER1 or CHARBUFFER2, holding the template
+    page_id: Set to the matching page ID on success
+    start_us: fingerprint_now_us() when the scan began, for the statistics
+   Returns: true if the sensor found a matching template
+*/
+bool fingerprint_identify(uint8_t buffer, uint16_t *page_id, uint32_t start_us) {
+    fingerprint_match_stats *stats = &g_fingerprint_match_stats;
+
+    // A page that was re-enrolled since it last matched just costs a miss
+    bool tried;
+    bool fast = recent_search(buffer, page_id, &tried);
+    bool matched = fast;
+    uint32_t full_us = 0;
+    if (!fast) {
+        if (tried) stats->fast_misses++;
+        uint32_t search_start_us = link_now_us();
+        matched = search_pages(buffer, 0, FINGERPRINT_LIBRARY_PAGES, page_id);
+        full_us = link_now_us() - search_start_us;
+    }
+    recent_update(matched, matched ? *page_id : 0, full_us);
+
+    uint32_t latency_us = link_now_us() - start_us;
+    stats->decisions++;
+    if (fast) {
+        stats->fast_hits++;
+        stats->hit_us += latency_us;
+    } else {
+        if (matched) stats->full_matches++;
+        else stats->no_matches++;
+        stats->miss_us += latency_us;
+    }
+    if (latency_us > stats->max_us) stats->max_us = latency_us;
+    return matched;
+}
+
+/* fingerprint_match
+   Purpose: Captures a finger image and looks it up in the sensor's database
+            (see fingerprint_identify())
+   Arguments:
+    page_id: Set to the matching page ID on success
+   Returns: true if the sensor found a matching template, false if there was
+    no finger, no match, or the link gave up after retries
+*/
+bool fingerprint_match(uint16_t *page_id) {
+    uint8_t args[1];
+    fingerprint_packet reply;
+    uint32_t start_us = link_now_us();
+
+    // Get print image
+    if (fingerprint_command(FINGERPRINT_GETIMAGE, NULL, 0, &reply) != FINGERPRINT_OK)
+        return false;
+
+    // Put template from image in buffer
+    args[0] = CHARBUFFER1;
+    if (fingerprint_command(FINGERPRINT_IMAGE2TZ, args, 1, &reply) != FINGERPRINT_OK)
+        return false;
+
+    return fingerprint_identify(CHARBUFFER1, page_id, start_us);
+}
@@ -0,0 +1,128 @@
+#include "ee14lib.h"
+
+// Keys from RM0394 section 3.3.5; writing them in order unlocks FLASH->CR
+#define FLASH_KEY1 0x45670123
+#define FLASH_KEY2 0xCDEF89AB
+
+// All of the FLASH->SR error flags; each is cleared by writing a 1 to it
+#define FLASH_SR_ERRORS (FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_WRPERR | \
+                         FLASH_SR_PGAERR | FLASH_SR_SIZERR | FLASH_SR_PGSERR | \
+                         FLASH_SR_MISERR | FLASH_SR_FASTERR | FLASH_SR_RDERR | \
+                         FLASH_SR_OPTVERR)
+
+// Unlock the flash control register if it is locked, and clear any error
+// flags left over from a previous operation (the next one won't start
+// otherwise).
+static void flash_unlock() {
+    while (FLASH->SR & FLASH_SR_BSY)
+        ;
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+    FLASH->SR = FLASH_SR_ERRORS | FLASH_SR_EOP;
+}
+
+// Wait for the current operation to finish and report whether it failed.
+static EE14Lib_Err flash_wait() {
+    while (FLASH->SR & FLASH_SR_BSY)
+        ;
+    if (FLASH->SR & FLASH_SR_ERRORS) {
+        FLASH->SR = FLASH_SR_ERRORS;
+        return EE14Lib_ERR_FLASH;
+    }
+    FLASH->SR = FLASH_SR_EOP;
+    return EE14Lib_Err_OK;
+}
+
+// Set by NMI_Handler() when a read hits an uncorrectable ECC error
+static volatile bool g_ecc_error;
+
+// Reading a double word whose ECC can't be corrected (its programming was cut
+// short by a power loss) raises an NMI with FLASH_ECCR_ECCD set. Clear it and
+// let flash_read_dword() report it; any other NMI hangs, like the default
+// handler.
+extern "C" void NMI_Handler()
+{
+    if (FLASH->ECCR & FLASH_ECCR_ECCD) {
+        FLASH->ECCR |= FLASH_ECCR_ECCD;
+        g_ecc_error = true;
+        return;
+    }
+    while (1)
+        ;
+}
+
+// Reset the flash data cache, which an erase doesn't update: lines cached
+// before the erase would otherwise keep reading back as the old contents.
+// DCRST only works while the cache is off (RM0394 section 3.3.4).
+static void flash_reset_data_cache() {
+    uint32_t dcen = FLASH->ACR & FLASH_ACR_DCEN;
+    FLASH->ACR &= ~FLASH_ACR_DCEN;
+    FLASH->ACR |= FLASH_ACR_DCRST;
+    FLASH->ACR &= ~FLASH_ACR_DCRST;
+    FLASH->ACR |= dcen;
+}
+
+// Erase one 2 KB flash page (every byte reads back as 0xFF afterwards).
+//   page: Page number, 0 to FLASH_PAGE_COUNT-1
+// Returns EE14Lib_ERR_INVALID_CONFIG for a bad page number, EE14Lib_ERR_FLASH
+// if the controller reported an error, otherwise EE14Lib_Err_OK.
+EE14Lib_Err flash_erase_page(unsigned int page)
+{
+    if (page >= FLASH_PAGE_COUNT) {
+        return EE14Lib_ERR_INVALID_CONFIG;
+    }
+
+    flash_unlock();
+    FLASH->CR &= ~FLASH_CR_PNB;
+    FLASH->CR |= FLASH_CR_PER | (page << FLASH_CR_PNB_Pos);
+    FLASH->CR |= FLASH_CR_STRT;
+    EE14Lib_Err err = flash_wait();
+    FLASH->CR &= ~(FLASH_CR_PER | FLASH_CR_PNB);
+    FLASH->CR |= FLASH_CR_LOCK;
+    flash_reset_data_cache();
+    return err;
+}
+
+// Program one 64-bit double word. The L432 only programs whole double words,
+// and only into a location that is still erased.
+//   address: Flash address, must be 8-byte aligned
+//   value: Data to write
+// Returns EE14Lib_ERR_INVALID_CONFIG for a misaligned address, EE14Lib_ERR_FLASH
+// if the controller reported an error, otherwise EE14Lib_Err_OK.
+EE14Lib_Err flash_program_dword(uintptr_t address, uint64_t value)
+{
+    if (address & 0x7) {
+        return EE14Lib_ERR_INVALID_CONFIG;
+    }
+
+    flash_unlock();
+    FLASH->CR |= FLASH_CR_PG;
+    // The two halves must be written back to back, low word first
+    *(volatile uint32_t *)address = (uint32_t)value;
+    *(volatile uint32_t *)(address + 4) = (uint32_t)(value >> 32);
+    EE14Lib_Err err = flash_wait();
+    FLASH->CR &= ~FLASH_CR_PG;
+    FLASH->CR |= FLASH_CR_LOCK;
+    return err;
+}
+
+// Read one 64-bit double word, checking it for an uncorrectable ECC error.
+//   address: Flash address, must be 8-byte aligned
+//   value: Filled in with the data
+// Returns EE14Lib_ERR_INVALID_CONFIG for a misaligned address, EE14Lib_ERR_FLASH
+// if the double word's ECC failed (value is then meaningless), otherwise
+// EE14Lib_Err_OK.
+EE14Lib_Err flash_read_dword(uintptr_t address, uint64_t *value)
+{
+    if (address & 0x7) {
+        return EE14Lib_ERR_INVALID_CONFIG;
+    }
+
+    const volatile uint32_t *p = (const volatile uint32_t *)address;
+    g_ecc_error = false;
+    *value = p[0] | ((uint64_t)p[1] << 32);
+    __DSB();
+    return g_ecc_error ? EE14Lib_ERR_FLASH : EE14Lib_Err_OK;
+}
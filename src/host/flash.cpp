@@ -0,0 +1,136 @@
+/* Simulated flash for host builds, in place of src/flash.cpp
+ *
+ * Behaves like NOR flash: an erase sets a page to 0xFF, and a double word
+ * can only be programmed while it is still erased. host.h can cut the power
+ * partway through any operation; a double word left half programmed fails
+ * its ECC check when read back, as it can on the chip.
+ */
+
+#include "ee14lib.h"
+#include "host.h"
+
+alignas(8) uint8_t host_flash[FLASH_PAGE_SIZE * FLASH_PAGE_COUNT];
+
+static uint32_t g_erases[FLASH_PAGE_COUNT];
+static uint8_t g_torn[sizeof(host_flash) / 8 / 8]; // Bit per double word with bad ECC
+static uint32_t g_ops;            // Completed operations
+static bool g_cut_armed;
+static uint32_t g_cut_at;         // Operation that the cut interrupts
+static int g_cut_how;
+static bool g_powered = true;
+
+// Erased before anything reads it, like a chip fresh from the factory
+static struct host_flash_init {
+    host_flash_init() { host_flash_reset(); }
+} g_host_flash_init;
+
+void host_flash_reset() {
+    for (uint32_t i = 0; i < sizeof(host_flash); i++) host_flash[i] = 0xFF;
+    for (int p = 0; p < FLASH_PAGE_COUNT; p++) g_erases[p] = 0;
+    for (uint32_t i = 0; i < sizeof(g_torn); i++) g_torn[i] = 0;
+    g_ops = 0;
+    g_cut_armed = false;
+    g_powered = true;
+}
+
+void host_flash_cut_power(uint32_t ops, int how) {
+    g_cut_armed = true;
+    g_cut_at = g_ops + ops;
+    g_cut_how = how;
+}
+
+void host_flash_power_on() {
+    g_cut_armed = false;
+    g_powered = true;
+}
+
+bool host_flash_powered() {
+    return g_powered;
+}
+
+uint32_t host_flash_ops() {
+    return g_ops;
+}
+
+uint32_t host_flash_erases(unsigned int page) {
+    return page < FLASH_PAGE_COUNT ? g_erases[page] : 0;
+}
+
+// Marks (or clears) the double word at byte offset `at` of host_flash as torn
+static void set_torn(uint32_t at, bool torn) {
+    uint32_t dword = at / 8;
+    if (torn)
+        g_torn[dword / 8] |= 1 << (dword % 8);
+    else
+        g_torn[dword / 8] &= ~(1 << (dword % 8));
+}
+
+// Whether the power goes now, at the start of an operation
+static bool host_flash_cut_now() {
+    if (g_cut_armed && g_ops == g_cut_at) {
+        g_cut_armed = false;
+        g_powered = false;
+        return true;
+    }
+    return false;
+}
+
+EE14Lib_Err flash_erase_page(unsigned int page)
+{
+    if (page >= FLASH_PAGE_COUNT) {
+        return EE14Lib_ERR_INVALID_CONFIG;
+    }
+    if (!g_powered) return EE14Lib_ERR_FLASH;
+
+    uint8_t *p = &host_flash[page * FLASH_PAGE_SIZE];
+    if (host_flash_cut_now()) {
+        if (g_cut_how == HOST_FLASH_CUT_PARTIAL)
+            for (int i = FLASH_PAGE_SIZE / 2; i < FLASH_PAGE_SIZE; i += 8) {
+                for (int b = 0; b < 8; b++) p[i + b] = 0xFF;
+                set_torn(page * FLASH_PAGE_SIZE + i, false);
+            }
+        return EE14Lib_ERR_FLASH;
+    }
+    for (int i = 0; i < FLASH_PAGE_SIZE; i += 8) {
+        for (int b = 0; b < 8; b++) p[i + b] = 0xFF;
+        set_torn(page * FLASH_PAGE_SIZE + i, false);
+    }
+    g_erases[page]++;
+    g_ops++;
+    return EE14Lib_Err_OK;
+}
+
+EE14Lib_Err flash_program_dword(uintptr_t address, uint64_t value)
+{
+    if (address & 0x7) {
+        return EE14Lib_ERR_INVALID_CONFIG;
+    }
+    if (!g_powered) return EE14Lib_ERR_FLASH;
+
+    volatile uint32_t *p = (volatile uint32_t *)address;
+    if (host_flash_cut_now()) {
+        if (g_cut_how == HOST_FLASH_CUT_PARTIAL) {
+            p[0] &= (uint32_t)value;
+            set_torn(address - (uintptr_t)host_flash, true);
+        }
+        return EE14Lib_ERR_FLASH;
+    }
+    // Like the PROGERR check: the double word must still be erased
+    if (p[0] != 0xFFFFFFFF || p[1] != 0xFFFFFFFF) return EE14Lib_ERR_FLASH;
+    p[0] = (uint32_t)value;
+    p[1] = (uint32_t)(value >> 32);
+    g_ops++;
+    return EE14Lib_Err_OK;
+}
+
+EE14Lib_Err flash_read_dword(uintptr_t address, uint64_t *value)
+{
+    if (address & 0x7) {
+        return EE14Lib_ERR_INVALID_CONFIG;
+    }
+
+    uint32_t dword = (address - (uintptr_t)host_flash) / 8;
+    const volatile uint32_t *p = (const volatile uint32_t *)address;
+    *value = p[0] | ((uint64_t)p[1] << 32);
+    return (g_torn[dword / 8] >> (dword % 8)) & 1 ? EE14Lib_ERR_FLASH : EE14Lib_Err_OK;
+}
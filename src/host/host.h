@@ -0,0 +1,35 @@
+/* Controls for the simulated peripherals in host builds
+ *
+ * Only tests and host tools use these; the drivers see the usual registers
+ * and functions (see stm32l432xx.h).
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+
+// How the flash operation hit by a power cut ends up
+#define HOST_FLASH_CUT_BEFORE 0  // Not started: flash unchanged
+#define HOST_FLASH_CUT_PARTIAL 1 // Half done: low word of a double word
+                                 // programmed (and its ECC bad), second half
+                                 // of a page erased
+
+// Erase every page and zero the counters, with the power on
+void host_flash_reset();
+// Lose power during the flash operation after the next `ops` complete ones.
+// That operation ends up as `how` says and reports EE14Lib_ERR_FLASH, and so
+// does every operation after it until host_flash_power_on().
+void host_flash_cut_power(uint32_t ops, int how);
+// Power back on (the "reboot" after a cut); flash keeps what was written
+void host_flash_power_on();
+bool host_flash_powered();
+// Erases plus double-word programs completed since host_flash_reset()
+uint32_t host_flash_ops();
+// Times a page has been erased since host_flash_reset()
+uint32_t host_flash_erases(unsigned int page);
+
+// One TIM16 update interrupt, and the PendSV it pends (a swtimer tick)
+void host_tim16_tick();
+
+#endif
@@ -0,0 +1,73 @@
+/* Simulated peripherals for host builds (see stm32l432xx.h) */
+
+#include "stm32l432xx.h"
+#include <stdio.h>
+#include <chrono>
+
+// Reported as the core clock so that DWT cycles read as nanoseconds
+uint32_t SystemCoreClock = 1000000000;
+
+GPIO_TypeDef host_gpioa, host_gpiob, host_gpioc, host_gpioh;
+USART_TypeDef host_usart1, host_usart2;
+TIM_TypeDef host_tim1, host_tim2, host_tim15, host_tim16;
+RCC_TypeDef host_rcc;
+DWT_Type host_dwt;
+CoreDebug_Type host_coredebug;
+SCB_Type host_scb;
+
+#define HOST_USART_READY (USART_ISR_TXE | USART_ISR_TC | USART_ISR_TEACK | USART_ISR_REACK)
+
+host_usart_isr::operator uint32_t() const {
+    return HOST_USART_READY;
+}
+
+host_usart_isr &host_usart_isr::operator=(uint32_t value) {
+    (void)value;
+    return *this;
+}
+
+host_usart_isr &host_usart_isr::operator&=(uint32_t value) {
+    (void)value;
+    return *this;
+}
+
+host_usart_isr &host_usart_isr::operator|=(uint32_t value) {
+    (void)value;
+    return *this;
+}
+
+// USART2 is the serial monitor; nothing is attached to USART1 on a host
+host_usart_tdr &host_usart_tdr::operator=(uint32_t value) {
+    if (this == &host_usart2.TDR) putchar(value & 0xFF);
+    return *this;
+}
+
+static uint64_t host_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t g_cyccnt_origin = host_ns();
+
+host_cyccnt::operator uint32_t() const {
+    return (uint32_t)(host_ns() - g_cyccnt_origin);
+}
+
+host_cyccnt &host_cyccnt::operator=(uint32_t value) {
+    g_cyccnt_origin = host_ns() - value;
+    return *this;
+}
+
+extern "C" void TIM1_UP_TIM16_IRQHandler();
+extern "C" void PendSV_Handler();
+
+// One TIM16 update as the board would take it: the update interrupt, then
+// PendSV if the handler pended it, as the core would tail-chain into it
+void host_tim16_tick() {
+    host_tim16.SR |= TIM_SR_UIF;
+    TIM1_UP_TIM16_IRQHandler();
+    if (host_scb.ICSR & SCB_ICSR_PENDSVSET_Msk) {
+        host_scb.ICSR &= ~SCB_ICSR_PENDSVSET_Msk;
+        PendSV_Handler();
+    }
+}
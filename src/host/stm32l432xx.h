@@ -0,0 +1,193 @@
+/* Host stand-in for the CMSIS device header
+ *
+ * Lets the drivers build and run on a PC (the native environments in
+ * platformio.ini put src/host first on the include path). Each peripheral
+ * is a plain struct in RAM with the same register names and bit macros as
+ * the real header, so driver code runs unchanged, with a few registers
+ * simulated where a driver waits on hardware:
+ *   - USARTx->ISR always reads as ready to transmit with nothing received;
+ *     bytes written to USART2->TDR go to stdout (the serial monitor)
+ *   - DWT->CYCCNT counts host nanoseconds, and SystemCoreClock is 1 GHz, so
+ *     cycle counts read as ns
+ *   - interrupts never fire by themselves; host_tim16_tick() (host.h) runs
+ *     the TIM16 update handler and the PendSV it pends, like one timer tick
+ *   - flash is a RAM array (src/host/flash.cpp stands in for the driver);
+ *     host.h can cut the power in the middle of a write
+ */
+
+#ifndef STM32L432XX_H
+#define STM32L432XX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO volatile
+#define __NVIC_PRIO_BITS 4
+
+typedef enum {
+    PendSV_IRQn = -2,
+    TIM1_UP_TIM16_IRQn = 25,
+    USART1_IRQn = 37,
+    USART2_IRQn = 38,
+} IRQn_Type;
+
+// Reads as idle and ready: TX empty, transfer complete, both directions
+// acknowledged. Writes (clearing TC, for instance) are ignored.
+struct host_usart_isr {
+    operator uint32_t() const;
+    host_usart_isr &operator=(uint32_t value);
+    host_usart_isr &operator&=(uint32_t value);
+    host_usart_isr &operator|=(uint32_t value);
+};
+
+// Sends the byte to the host side of the port (stdout for USART2)
+struct host_usart_tdr {
+    host_usart_tdr &operator=(uint32_t value);
+};
+
+// Nanoseconds since the last write, wrapping like the real counter
+struct host_cyccnt {
+    operator uint32_t() const;
+    host_cyccnt &operator=(uint32_t value);
+};
+
+typedef struct {
+    __IO uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR;
+    __IO uint32_t AFR[2];
+    __IO uint32_t BRR;
+} GPIO_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR1, CR2, CR3, BRR, GTPR, RTOR, RQR;
+    host_usart_isr ISR;
+    __IO uint32_t ICR, RDR;
+    host_usart_tdr TDR;
+} USART_TypeDef;
+
+// Same order as the real block: timer.cpp finds CCR1-4 at word 13 onwards
+typedef struct {
+    __IO uint32_t CR1, CR2, SMCR, DIER, SR, EGR, CCMR1, CCMR2, CCER, CNT, PSC, ARR, RCR;
+    __IO uint32_t CCR1, CCR2, CCR3, CCR4, BDTR;
+} TIM_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR, ICSCR, CFGR, PLLCFGR, AHB1ENR, AHB2ENR, APB1ENR1, APB2ENR, CCIPR;
+} RCC_TypeDef;
+
+typedef struct {
+    __IO uint32_t CTRL;
+    host_cyccnt CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+    __IO uint32_t CPUID, ICSR, VTOR, AIRCR, SCR, CCR;
+} SCB_Type;
+
+extern GPIO_TypeDef host_gpioa, host_gpiob, host_gpioc, host_gpioh;
+extern USART_TypeDef host_usart1, host_usart2;
+extern TIM_TypeDef host_tim1, host_tim2, host_tim15, host_tim16;
+extern RCC_TypeDef host_rcc;
+extern DWT_Type host_dwt;
+extern CoreDebug_Type host_coredebug;
+extern SCB_Type host_scb;
+
+#define GPIOA (&host_gpioa)
+#define GPIOB (&host_gpiob)
+#define GPIOC (&host_gpioc)
+#define GPIOH (&host_gpioh)
+// The whole 256 KB of flash, erased at start-up
+extern uint8_t host_flash[];
+#define FLASH_BASE ((uintptr_t)host_flash)
+
+#define USART1 (&host_usart1)
+#define USART2 (&host_usart2)
+#define TIM1 (&host_tim1)
+#define TIM2 (&host_tim2)
+#define TIM15 (&host_tim15)
+#define TIM16 (&host_tim16)
+#define RCC (&host_rcc)
+#define DWT (&host_dwt)
+#define CoreDebug (&host_coredebug)
+#define SCB (&host_scb)
+
+// Interrupts: the host is single threaded and no handler runs unless
+// something calls it, so masking has nothing to do
+static inline uint32_t __get_PRIMASK() { return 0; }
+static inline void __set_PRIMASK(uint32_t primask) { (void)primask; }
+static inline void __disable_irq() {}
+static inline void __enable_irq() {}
+static inline void __DSB() {}
+static inline void __ISB() {}
+static inline void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) { (void)irq; (void)priority; }
+static inline void NVIC_EnableIRQ(IRQn_Type irq) { (void)irq; }
+static inline uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+
+#define BIT(n) ((uint32_t)1 << (n))
+
+#define RCC_AHB2ENR_GPIOAEN BIT(0)
+#define RCC_AHB2ENR_GPIOBEN BIT(1)
+#define RCC_AHB2ENR_GPIOCEN BIT(2)
+#define RCC_AHB2ENR_GPIOHEN BIT(7)
+#define RCC_APB1ENR1_TIM2EN BIT(0)
+#define RCC_APB1ENR1_USART2EN BIT(17)
+#define RCC_APB2ENR_TIM1EN BIT(11)
+#define RCC_APB2ENR_USART1EN BIT(14)
+#define RCC_APB2ENR_TIM15EN BIT(16)
+#define RCC_APB2ENR_TIM16EN BIT(17)
+#define RCC_CCIPR_USART1SEL (3U << 0)
+#define RCC_CCIPR_USART1SEL_0 (1U << 0)
+#define RCC_CCIPR_USART2SEL (3U << 2)
+#define RCC_CCIPR_USART2SEL_0 (1U << 2)
+
+#define USART_CR1_UE BIT(0)
+#define USART_CR1_RE BIT(2)
+#define USART_CR1_TE BIT(3)
+#define USART_CR1_RXNEIE BIT(5)
+#define USART_CR1_M (BIT(12) | BIT(28))
+#define USART_CR1_OVER8 BIT(15)
+#define USART_CR2_STOP (3U << 12)
+#define USART_ISR_PE BIT(0)
+#define USART_ISR_FE BIT(1)
+#define USART_ISR_NE BIT(2)
+#define USART_ISR_ORE BIT(3)
+#define USART_ISR_RXNE BIT(5)
+#define USART_ISR_TC BIT(6)
+#define USART_ISR_TXE BIT(7)
+#define USART_ISR_TEACK BIT(21)
+#define USART_ISR_REACK BIT(22)
+#define USART_ICR_PECF BIT(0)
+#define USART_ICR_FECF BIT(1)
+#define USART_ICR_NCF BIT(2)
+#define USART_ICR_ORECF BIT(3)
+
+#define TIM_CR1_CEN BIT(0)
+#define TIM_DIER_UIE BIT(0)
+#define TIM_SR_UIF BIT(0)
+#define TIM_EGR_UG BIT(0)
+#define TIM_BDTR_MOE BIT(15)
+#define TIM_CCMR1_OC1M (BIT(4) | BIT(5) | BIT(6) | BIT(16))
+#define TIM_CCMR1_OC1M_1 BIT(5)
+#define TIM_CCMR1_OC1M_2 BIT(6)
+#define TIM_CCMR1_OC1PE BIT(3)
+#define TIM_CCMR1_OC2M (BIT(12) | BIT(13) | BIT(14) | BIT(24))
+#define TIM_CCMR1_OC2M_1 BIT(13)
+#define TIM_CCMR1_OC2M_2 BIT(14)
+#define TIM_CCMR1_OC2PE BIT(11)
+#define TIM_CCMR2_OC3M (BIT(4) | BIT(5) | BIT(6) | BIT(16))
+#define TIM_CCMR2_OC3M_1 BIT(5)
+#define TIM_CCMR2_OC3M_2 BIT(6)
+#define TIM_CCMR2_OC3PE BIT(3)
+#define TIM_CCMR2_OC4M (BIT(12) | BIT(13) | BIT(14) | BIT(24))
+#define TIM_CCMR2_OC4M_1 BIT(13)
+#define TIM_CCMR2_OC4M_2 BIT(14)
+#define TIM_CCMR2_OC4PE BIT(11)
+
+#define DWT_CTRL_CYCCNTENA_Msk BIT(0)
+#define CoreDebug_DEMCR_TRCENA_Msk BIT(24)
+#define SCB_ICSR_PENDSVSET_Msk BIT(28)
+
+#endif
@@ -7,31 +7,48 @@
  */
 
 #include "ee14lib.h"
-#include <cstdio>
+#include "fingerprint.h"
+#include "config_store.h"
+#include "trace.h"
+#include "swtimer.h"
+#include "board.h"
+#include "scan.h"
+#include "console.h"
+#include <string.h>
 
 // Serial monitor print helper
 #define printf(msg) serial_write(USART2, msg, sizeof(msg) - 1)
 
-// Packet and Command constants
-#define FINGERPRINT_START_CODE_H 0xEF
-#define FINGERPRINT_START_CODE_L 0x01
-#define FINGERPRINT_ADDR 0xFFFFFFFF
-#define FINGERPRINT_COMMANDPACKET 0x01
-#define FINGERPRINT_ACKPACKET 0x07
-#define FINGERPRINT_GETIMAGE 0x01
-#define FINGERPRINT_IMAGE2TZ 0x02
-#define FINGERPRINT_REGMODEL 0x05
-#define FINGERPRINT_STORE 0x06
-#define FINGERPRINT_ENROLLSTART 0x22
-#define FINGERPRINT_ENROLL1 0x23
-#define FINGERPRINT_ENROLL2 0x24
-#define FINGERPRINT_ENROLL3 0x25
-#define FINGERPRINT_TEMPLATECOUNT 0x1D
-#define FINGERPRINT_VERIFYPASSWORD 0x13
-#define FINGERPRINT_SEARCH 0x04
-#define CHARBUFFER1 0x01
-#define CHARBUFFER2 0x02
-
+// Servo duty cycles (0-1023) for the lid closed and open
+static volatile int g_duty_closed;
+static volatile int g_duty_open;
+
+// Sensor pages holding a template, bit n = page n (CONFIG_KEY_ENROLLED)
+static uint8_t g_enrolled[CONFIG_ENROLLED_BYTES];
+
+// Continuous scanning (scan.h) instead of one scan at a time
+static bool g_continuous;
+
+// Settings that "get"/"set" on the serial monitor reach, their defaults and
+// the values they may take (min to max in steps of step)
+typedef struct {
+    const char *name;
+    uint8_t key;
+    uint32_t default_value;
+    uint32_t min_value;
+    uint32_t max_value;
+    uint32_t step;
+} setting;
+
+static const setting g_settings[] = {
+    {"duty_closed", CONFIG_KEY_DUTY_CLOSED, 51, 0, 1023, 1},      // 0 degrees
+    {"duty_open", CONFIG_KEY_DUTY_OPEN, 77, 0, 1023, 1},          // 90 degrees, lid open
+    {"sensor_baud", CONFIG_KEY_SENSOR_BAUD, 57600, 9600, 115200, 9600}, // ZFM-20: 9600*N
+    {"sensor_password", CONFIG_KEY_SENSOR_PASSWORD, 0x00000000, 0, 0xFFFFFFFF, 1},
+    {"scan_mode", CONFIG_KEY_SCAN_MODE, 0, 0, 1, 1},              // 1 = continuous scanning
+};
+
+#define SETTING_COUNT (int)(sizeof(g_settings) / sizeof(g_settings[0]))
 
 /* delay_ms
 Purpose: Lazy delay with for loop, approximately in milliseconds
@@ -70,49 +87,19 @@ void print_hex_response(char *data, int len) {
     serial_write(USART2, "\r\n", 2);
 }
 
-/* send_fingerprint_command
-   Purpose: Sends command packet to sensor
-   Arguments: 
-    command: Command byte, see documentation
-    args: Optional arguments, see documentation per command
-    args_len: Length of arguments, see documentation per command
-   Returns: None--to see if each command is successful, monitor UART1 on AD2  
-*/
-void send_fingerprint_command(uint8_t command, uint8_t *args, uint8_t args_len) {
-    uint8_t packet[32];
-    uint16_t idx = 0;
-    uint16_t checksum = 0;
-
-    packet[idx++] = FINGERPRINT_START_CODE_H;
-    packet[idx++] = FINGERPRINT_START_CODE_L;
-    for (int i = 0; i < 4; i++) packet[idx++] = 0xFF;
-    packet[idx++] = FINGERPRINT_COMMANDPACKET;
-
-    uint16_t payload_len = 1 + args_len + 2;
-    packet[idx++] = (payload_len >> 8) & 0xFF;
-    packet[idx++] = payload_len & 0xFF;
-    packet[idx++] = command;
-
-    for (uint8_t i = 0; i < args_len; i++) packet[idx++] = args[i];
-
-    checksum = FINGERPRINT_COMMANDPACKET + (payload_len >> 8) + (payload_len & 0xFF) + command;
-    for (uint8_t i = 0; i < args_len; i++) checksum += args[i];
-    packet[idx++] = (checksum >> 8) & 0xFF;
-    packet[idx++] = checksum & 0xFF;
-
-    for (uint8_t i = 0; i < idx; i++) {
-        serial_write(USART1, (char *)&packet[i], 1);
-    }
-}
-
-/* write_only_enroll
-   Purpose: Enrolls new fingerprint on scanner with specified ID
+/* enroll_finger
+   Purpose: Enrolls new fingerprint on scanner with specified ID, and marks
+            the page as taken in the stored bitmap once the sensor confirms
+            the STORE
    Arguments:
-        page_id: ID for new print, 0-255
-   Returns: None--to see if each command is successful, monitor UART1 on AD2  
+        page_id: ID for new print, below CONFIG_ENROLLED_PAGES
+   Returns: true if the sensor stored the template
 */
-void write_only_enroll(uint16_t page_id) {
+bool enroll_finger(uint16_t page_id) {
     uint8_t args[4];
+    fingerprint_packet reply;
+
+    if (page_id >= CONFIG_ENROLLED_PAGES) return false;
 
     // Initialization
     args[0] = (page_id >> 8) & 0xFF;
@@ -152,36 +139,263 @@ void write_only_enroll(uint16_t page_id) {
     delay_ms(300); printf("Step 4 done\n");
 
 
-    // Store full print on sensor
+    // Store full print on sensor, and only count it if the sensor says so
     args[0] = CHARBUFFER1;
     args[1] = (page_id >> 8) & 0xFF;
     args[2] = page_id & 0xFF;
-    send_fingerprint_command(FINGERPRINT_STORE, args, 3);
-    delay_ms(300); printf("Step 5 done, stored successfully.\n");
+    if (fingerprint_command(FINGERPRINT_STORE, args, 3, &reply) != FINGERPRINT_OK) {
+        printf("Step 5 failed, nothing stored.\n");
+        return false;
+    }
+    printf("Step 5 done, stored successfully.\n");
+
+    // Remember the slot is taken so boot doesn't have to ask the sensor
+    g_enrolled[page_id / 8] |= 1 << (page_id % 8);
+    config_set(CONFIG_KEY_ENROLLED, g_enrolled, sizeof(g_enrolled));
+    return true;
 }
 
-/* write_only_match
-   Purpose: Matches finger image with database to check for valid print
-   Arguments: None
-   Returns: None--to see if each command is successful, monitor UART1 on AD2  
+/* enrolled_count
+Purpose: Counts the pages marked in the enrollment bitmap
+Arguments: None
+Returns: Number of enrolled pages
 */
-void write_only_match() {
-    uint8_t args[4];
-    // Get print image
-    send_fingerprint_command(FINGERPRINT_GETIMAGE, NULL, 0);
-    delay_ms(50);
-    args[0] = CHARBUFFER1;
+int enrolled_count() {
+    int count = 0;
+    for (int page = 0; page < CONFIG_ENROLLED_PAGES; page++)
+        if (g_enrolled[page / 8] & (1 << (page % 8))) count++;
+    return count;
+}
 
-    // Put template from image in buffer
-    send_fingerprint_command(FINGERPRINT_IMAGE2TZ, args, 1);
-    delay_ms(50);
+// Fires 400 ms after the lid opens
+static swtimer g_close_lid;
 
-    // Search for template on sensor
-    args[0] = CHARBUFFER1; args[1] = 0x00; args[2] = 0x00; args[3] = 0xC8;
-    send_fingerprint_command(FINGERPRINT_SEARCH, args, 4);
-    delay_ms(50);
+/* close_lid
+Purpose: Timer callback, turns the servo back to the closed position
+Arguments: 
+ arg: Pointer to the closed duty cycle
+Returns: None
+*/
+static void close_lid(void *arg) {
+    timer_set_pwm_duty(TIM2, A4, *(volatile int *)arg);
+}
+
+/* print_link_stats
+Purpose: Prints fingerprint link-layer counters on one line
+Arguments: None
+Returns: None
+*/
+void print_link_stats() {
+    printf("link: csum_fail="); serial_write_uint(USART2, g_fingerprint_stats.checksum_failures);
+    printf(" resync="); serial_write_uint(USART2, g_fingerprint_stats.resyncs);
+    printf(" timeout="); serial_write_uint(USART2, g_fingerprint_stats.timeouts);
+    printf(" retry="); serial_write_uint(USART2, g_fingerprint_stats.retries);
+    printf(" reverify="); serial_write_uint(USART2, g_fingerprint_stats.reverifies);
+    printf(" stale="); serial_write_uint(USART2, g_fingerprint_stats.stale_bytes);
+    printf(" rx_drop="); serial_write_uint(USART2, serial_rx_dropped(USART1));
+    printf(" recover_avg_us=");
+    serial_write_uint(USART2, g_fingerprint_stats.recoveries ?
+        (uint32_t)(g_fingerprint_stats.recovery_us / g_fingerprint_stats.recoveries) : 0);
+    printf("\r\n");
+}
+
+/* print_match_stats
+Purpose: Prints the fast-path hit rate and match latencies on one line
+Arguments: None
+Returns: None
+*/
+void print_match_stats() {
+    const fingerprint_match_stats *stats = &g_fingerprint_match_stats;
+    uint32_t hits = stats->fast_hits;
+    uint32_t others = stats->decisions - hits;
+
+    printf("match: decisions="); serial_write_uint(USART2, stats->decisions);
+    printf(" fast_hit="); serial_write_uint(USART2, hits);
+    printf(" fast_miss="); serial_write_uint(USART2, stats->fast_misses);
+    printf(" full="); serial_write_uint(USART2, stats->full_matches);
+    printf(" none="); serial_write_uint(USART2, stats->no_matches);
+    printf(" hit_avg_us="); serial_write_uint(USART2, hits ? (uint32_t)(stats->hit_us / hits) : 0);
+    printf(" miss_avg_us="); serial_write_uint(USART2, others ? (uint32_t)(stats->miss_us / others) : 0);
+    printf(" max_us="); serial_write_uint(USART2, stats->max_us);
+    printf("\r\n");
+}
+
+/* print_scan_stats
+Purpose: Prints continuous-scan counters and decision latency percentiles
+Arguments: None
+Returns: None
+*/
+void print_scan_stats() {
+    printf("scan: decisions="); serial_write_uint(USART2, g_scan_stats.decisions);
+    printf(" matches="); serial_write_uint(USART2, g_scan_stats.matches);
+    printf(" duplicates="); serial_write_uint(USART2, g_scan_stats.duplicates);
+    printf(" errors="); serial_write_uint(USART2, g_scan_stats.errors);
+    printf(" p50_us="); serial_write_uint(USART2, scan_latency_percentile(50));
+    printf(" p99_us="); serial_write_uint(USART2, scan_latency_percentile(99));
+    printf("\r\n");
+}
+
+/* setting_find
+Purpose: Looks up a setting by the name typed on the serial monitor
+Arguments:
+ name: Setting name
+Returns: The setting, or NULL if there is none by that name
+*/
+const setting *setting_find(const char *name) {
+    for (int i = 0; i < SETTING_COUNT; i++)
+        if (strcmp(name, g_settings[i].name) == 0) return &g_settings[i];
+    return NULL;
+}
+
+/* setting_valid
+Purpose: Checks a value against a setting's range and step
+Arguments:
+ s: Setting
+ value: Candidate value
+Returns: true if the setting may take the value
+*/
+bool setting_valid(const setting *s, uint32_t value) {
+    if (value < s->min_value || value > s->max_value) return false;
+    return (value - s->min_value) % s->step == 0;
+}
+
+/* setting_get
+Purpose: Reads a setting from flash, or its default if it was never set or
+         the stored value is out of range
+Arguments:
+ s: Setting to read
+Returns: The value
+*/
+uint32_t setting_get(const setting *s) {
+    uint32_t value = config_get_u32(s->key, s->default_value);
+    return setting_valid(s, value) ? value : s->default_value;
 }
 
+/* print_setting
+Purpose: Prints one setting as name=value
+Arguments:
+ s: Setting to print
+Returns: None
+*/
+void print_setting(const setting *s) {
+    serial_write(USART2, s->name, strlen(s->name));
+    printf("="); serial_write_uint(USART2, setting_get(s));
+    printf("\r\n");
+}
+
+/* load_duties
+Purpose: Reads the servo positions from flash
+Arguments: None
+Returns: None
+*/
+void load_duties() {
+    g_duty_closed = setting_get(setting_find("duty_closed"));
+    g_duty_open = setting_get(setting_find("duty_open"));
+}
+
+/* apply_scan_mode
+Purpose: Switches between the serial loop and continuous scanning to match
+         the scan_mode setting, waiting out an outstanding capture first
+Arguments: None
+Returns: None
+*/
+void apply_scan_mode() {
+    bool continuous = setting_get(setting_find("scan_mode")) != 0;
+    if (continuous == g_continuous) return;
+    if (g_continuous) scan_end();
+    g_continuous = continuous;
+    if (g_continuous) scan_begin();
+}
+
+/* cmd_get
+Purpose: Console "get <setting>": prints a setting
+Arguments:
+ argv: Command words
+Returns: None
+*/
+void cmd_get(char **argv) {
+    const setting *s = setting_find(argv[1]);
+    if (!s) {
+        printf("unknown setting, try \"settings\"\r\n");
+        return;
+    }
+    print_setting(s);
+}
+
+/* cmd_set
+Purpose: Console "set <setting> <value>": saves a setting to flash. Servo
+         positions apply from the next open/close, the scan mode at once,
+         sensor settings from the next boot.
+Arguments:
+ argv: Command words
+Returns: None
+*/
+void cmd_set(char **argv) {
+    const setting *s = setting_find(argv[1]);
+    uint32_t value;
+    if (!s) {
+        printf("unknown setting, try \"settings\"\r\n");
+        return;
+    }
+    if (!console_parse_u32(argv[2], &value)) {
+        printf("value must be a number\r\n");
+        return;
+    }
+    if (!setting_valid(s, value)) {
+        printf("out of range: ");
+        serial_write_uint(USART2, s->min_value); printf("..");
+        serial_write_uint(USART2, s->max_value);
+        if (s->step != 1) {
+            printf(" in steps of "); serial_write_uint(USART2, s->step);
+        }
+        printf("\r\n");
+        return;
+    }
+    if (config_set_u32(s->key, value) != EE14Lib_Err_OK) {
+        printf("flash write failed\r\n");
+        return;
+    }
+    load_duties();
+    apply_scan_mode();
+    print_setting(s);
+}
+
+/* cmd_settings
+Purpose: Console "settings": prints every setting
+Arguments:
+ argv: Command words
+Returns: None
+*/
+void cmd_settings(char **argv) {
+    for (int i = 0; i < SETTING_COUNT; i++) print_setting(&g_settings[i]);
+}
+
+/* cmd_enroll
+Purpose: Console "enroll <page>": enrolls a finger at a sensor page
+Arguments:
+ argv: Command words
+Returns: None
+*/
+void cmd_enroll(char **argv) {
+    uint32_t page;
+    if (!console_parse_u32(argv[1], &page) || page >= CONFIG_ENROLLED_PAGES) {
+        printf("page must be 0-199\r\n");
+        return;
+    }
+    // Nothing else may talk to the sensor while it is enrolling
+    if (g_continuous) scan_end();
+    if (enroll_finger(page)) printf("enrolled\r\n");
+    else printf("enroll failed\r\n");
+    if (g_continuous) scan_begin();
+}
+
+static const console_command g_commands[] = {
+    {"get", 1, cmd_get, "get <setting>"},
+    {"set", 2, cmd_set, "set <setting> <value>"},
+    {"settings", 0, cmd_settings, "settings"},
+    {"enroll", 1, cmd_enroll, "enroll <page>"},
+};
+
 /* Main driver
    Purpose: Init UART and sensor, verify password, loop for matching fingerprint
    Arguments: None
@@ -189,40 +403,83 @@ void write_only_match() {
    OR run match script on WaveForms, see if output pin goes high 
 */
 int main() {
-    // Initialize GPIO/UART
-    host_serial_init();
-    gpio_config_mode(D9, OUTPUT);
+    // Time boot up to the first sensor command
+    cycle_counter_init();
+
+    // Load calibration, sensor settings and the enrolled pages saved in
+    // flash; defaults on first boot
+    config_store_init();
+    load_duties();
+    uint32_t sensor_baud = setting_get(setting_find("sensor_baud"));
+    uint32_t sensor_password = setting_get(setting_find("sensor_password"));
+    g_continuous = setting_get(setting_find("scan_mode")) != 0;
+    config_get(CONFIG_KEY_ENROLLED, g_enrolled, sizeof(g_enrolled));
+
+    // Initialize GPIO/UART: every pin and clock from the board table at once
+    // (D9 output, A6 sensor input, both serial ports)
+    board_init();
+    if (sensor_baud != 57600 && serial_set_baud(USART1, sensor_baud) != EE14Lib_Err_OK)
+        printf("sensor_baud not usable, staying at 57600\r\n");
     timer_config_pwm(TIM2, 50); // Start 50 Hz PWM
+    swtimer_init();
 
-    
-    volatile int duty_closed = 51; // 0 degrees
-    volatile int duty_open = 77; // 90 degrees, lid open
-    timer_config_channel_pwm(TIM2, A4, duty_closed); 
-
-    // Configure sensor pin
-    gpio_config_mode(A6, INPUT);
+    timer_config_channel_pwm(TIM2, A4, g_duty_closed); 
 
     // "wake up" sensor
-    uint8_t password_args[4] = {0x00, 0x00, 0x00, 0x00};
-    send_fingerprint_command(FINGERPRINT_VERIFYPASSWORD, password_args, 4);
-
+    uint32_t boot_cycles = cycle_counter_read();
+    fingerprint_link_init(sensor_password);
+    printf("boot: "); serial_write_uint(USART2, boot_cycles);
+    printf(" cycles to first sensor command\r\n");
+    printf("enrolled pages: "); serial_write_uint(USART2, enrolled_count());
+    printf("\r\n");
 
+    // Settings and enrollment from the serial monitor, e.g. "set duty_open 80"
+    console_init();
 
+#ifdef FINGERPRINT_TRACE
+    // Capture USART1 traffic from the first scan on; see scripts/trace_to_header.py
+    trace_start();
+#endif
 
     // Check for matching finger repeatedly
+    uint32_t scans = 0;
+    if (g_continuous) scan_begin();
     while (1) {
-        serial_write(USART2, "Place finger to match...\n", 25);
-        write_only_match();
-        if (gpio_read(A6)) { // If finger match, open box, wait, then close
-            printf("Rotating");
-            timer_set_pwm_duty(TIM2, A4, duty_open);
-            delay_ms(400);
-            printf("returning back");
-            timer_set_pwm_duty(TIM2, A4, duty_closed);
+        bool matched;
+        bool decided = true;
+
+        if (g_continuous) {
+            // The next capture is already running while we act on this one;
+            // a finger still resting after a match keeps the lid open
+            scan_result result;
+            scan_step(&result);
+            decided = result.outcome == SCAN_MATCHED || result.outcome == SCAN_REJECTED;
+            matched = result.matched &&
+                      (result.outcome == SCAN_MATCHED || result.outcome == SCAN_DUPLICATE);
+        } else {
+            serial_write(USART2, "Place finger to match...\n", 25);
+            uint16_t page_id;
+            matched = fingerprint_match(&page_id);
         }
-        delay_ms(300);
-    }
 
-    // Enroll new fingerprint with id 12
-    //write_only_enroll(17);
+        // A6 is still driven by Match_detect.js when the AD2 is attached
+        if (matched || gpio_read(A6)) { // If finger match, open box; a timer closes it
+            if (decided) printf("Rotating\r\n");
+            timer_set_pwm_duty(TIM2, A4, g_duty_open);
+            // Close again in 400 ms without blocking the scan loop; another
+            // match before then just pushes the close back
+            swtimer_arm(&g_close_lid, 400, 0, close_lid, (void *)&g_duty_closed);
+        }
+        console_poll(g_commands, sizeof(g_commands) / sizeof(g_commands[0]));
+        if (!decided) continue;
+        if (++scans % 32 == 0) {
+            print_link_stats();
+            print_match_stats();
+            if (g_continuous) print_scan_stats();
+        }
+#ifdef FINGERPRINT_TRACE
+        if (matched || scans % 32 == 0) trace_dump(USART2);
+#endif
+        if (!g_continuous) delay_ms(300);
+    }
 }
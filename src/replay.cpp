@@ -0,0 +1,66 @@
+/* Replay a captured USART1 trace through the matching code
+ *
+ * Built by the "replay" PlatformIO environment in place of main.cpp. The
+ * link layer reads sensor replies from include/replay_trace.h (generated by
+ * scripts/trace_to_header.py) instead of USART1, timed relative to each
+ * command just as they were captured. Each decision is printed as CSV so
+ * two firmware revisions can be diffed:
+ *
+ *   replay,decision,<n>,<matched 0/1>,<page_id>,<latency_us>
+ *   replay,done,<decisions>,<matches>,<tx_mismatches>,<total_us>
+ *
+ * A nonzero tx_mismatches means this firmware sent different commands than
+ * the captured one, so the replies no longer line up with the requests.
+ */
+
+#include "ee14lib.h"
+#include "fingerprint.h"
+#include "trace.h"
+
+#if !__has_include("replay_trace.h")
+#error "include/replay_trace.h is missing; generate it with scripts/trace_to_header.py"
+#endif
+#include "replay_trace.h"
+
+// Serial monitor print helper
+#define printf(msg) serial_write(USART2, msg, sizeof(msg) - 1)
+
+/* Replay driver
+   Purpose: Runs fingerprint_match() against the trace until it is used up
+   Arguments: None
+   Returns: None--results are on the serial monitor
+*/
+int main() {
+    host_serial_init();
+    cycle_counter_init();
+    trace_now_us();
+
+    uint32_t decisions = 0;
+    uint32_t matches = 0;
+    uint32_t start_us = trace_now_us();
+
+    trace_replay_begin(g_replay_trace, sizeof(g_replay_trace));
+    while (!trace_replay_done()) {
+        uint16_t page_id = 0;
+        uint32_t t0 = trace_now_us();
+        bool matched = fingerprint_match(&page_id);
+        uint32_t latency_us = trace_now_us() - t0;
+
+        decisions++;
+        if (matched) matches++;
+        printf("replay,decision,"); serial_write_uint(USART2, decisions);
+        printf(","); serial_write_uint(USART2, matched);
+        printf(","); serial_write_uint(USART2, matched ? page_id : 0);
+        printf(","); serial_write_uint(USART2, latency_us);
+        printf("\r\n");
+    }
+
+    printf("replay,done,"); serial_write_uint(USART2, decisions);
+    printf(","); serial_write_uint(USART2, matches);
+    printf(","); serial_write_uint(USART2, trace_replay_mismatches());
+    printf(","); serial_write_uint(USART2, trace_now_us() - start_us);
+    printf("\r\n");
+
+    while (1)
+        ;
+}
@@ -0,0 +1,149 @@
+/* Continuous scanning
+ *
+ * Per scan: finish GETIMAGE -> if the last decided finger hasn't lifted yet,
+ * that's all; otherwise IMAGE2TZ -> SEARCH -> start the next GETIMAGE.
+ */
+
+#include "scan.h"
+#include "fingerprint.h"
+
+scan_stats g_scan_stats;
+
+static bool g_resting;           // The last decided finger hasn't lifted yet
+static bool g_previous_matched;
+static uint16_t g_previous_page;
+static uint32_t g_capture_us;    // When the outstanding GETIMAGE was sent
+static bool g_capturing;         // A GETIMAGE is outstanding
+
+/* start_capture
+   Purpose: Sends the next GETIMAGE without waiting for it
+   Arguments: None
+   Returns: None
+*/
+static void start_capture() {
+    g_capture_us = fingerprint_now_us();
+    fingerprint_command_start(FINGERPRINT_GETIMAGE, NULL, 0);
+    g_capturing = true;
+}
+
+/* scan_begin
+   Purpose: Starts continuous scanning; the first capture begins right away
+   Arguments: None
+   Returns: None
+*/
+void scan_begin() {
+    g_resting = false;
+    start_capture();
+}
+
+/* scan_end
+   Purpose: Stops continuous scanning, waiting out the outstanding capture so
+            the sensor is free for other commands
+   Arguments: None
+   Returns: None
+*/
+void scan_end() {
+    fingerprint_packet reply;
+    if (g_capturing) fingerprint_command_finish(FINGERPRINT_GETIMAGE, NULL, 0, &reply);
+    g_capturing = false;
+}
+
+/* record_latency
+   Purpose: Adds a decision latency to the histogram
+   Arguments:
+    latency_us: Latency of one decision
+   Returns: None
+*/
+static void record_latency(uint32_t latency_us) {
+    uint32_t bucket = latency_us / SCAN_LATENCY_BUCKET_US;
+    if (bucket >= SCAN_LATENCY_BUCKETS) bucket = SCAN_LATENCY_BUCKETS - 1;
+    g_scan_stats.latency_hist[bucket]++;
+}
+
+/* scan_step
+   Purpose: Completes the outstanding scan and starts the next capture
+   Arguments:
+    result: Filled in with what was on the glass and, for decisions, the
+     outcome and latency
+   Returns: None
+*/
+void scan_step(scan_result *result) {
+    fingerprint_packet reply;
+    uint8_t args[1];
+    uint32_t start_us = g_capture_us;
+
+    result->outcome = SCAN_ERROR;
+    result->matched = false;
+    result->page_id = 0;
+    result->latency_us = 0;
+
+    if (!g_capturing) start_capture();
+    int code = fingerprint_command_finish(FINGERPRINT_GETIMAGE, NULL, 0, &reply);
+    g_capturing = false;
+
+    if (code == FINGERPRINT_NOFINGER) {
+        g_resting = false; // Finger lifted; the next one gets a fresh decision
+        result->outcome = SCAN_NO_FINGER;
+        g_scan_stats.no_finger++;
+        start_capture();
+        return;
+    }
+
+    // Still the finger we just decided on: only watch for it lifting, so the
+    // next person's capture doesn't queue behind another IMAGE2TZ
+    if (g_resting && code == FINGERPRINT_OK) {
+        result->outcome = SCAN_DUPLICATE;
+        result->matched = g_previous_matched;
+        result->page_id = g_previous_page;
+        g_scan_stats.duplicates++;
+        start_capture();
+        return;
+    }
+
+    args[0] = CHARBUFFER1;
+    if (code != FINGERPRINT_OK ||
+        fingerprint_command(FINGERPRINT_IMAGE2TZ, args, 1, &reply) != FINGERPRINT_OK) {
+        g_scan_stats.errors++;
+        start_capture();
+        return;
+    }
+
+    uint16_t page_id = 0;
+    bool matched = fingerprint_identify(CHARBUFFER1, &page_id, start_us);
+
+    result->outcome = matched ? SCAN_MATCHED : SCAN_REJECTED;
+    result->matched = matched;
+    result->page_id = page_id;
+    result->latency_us = fingerprint_now_us() - start_us;
+    g_previous_matched = matched;
+    g_previous_page = page_id;
+    g_resting = true;
+
+    g_scan_stats.decisions++;
+    if (matched) g_scan_stats.matches++;
+    record_latency(result->latency_us);
+
+    // Keep the sensor busy while the caller acts on the result
+    start_capture();
+}
+
+/* scan_latency_percentile
+   Purpose: Reads a percentile off the decision latency histogram
+   Arguments:
+    percent: 1-100, e.g. 99 for the p99
+   Returns: Upper edge of the bucket holding that percentile, in
+    microseconds (0 if there were no decisions)
+*/
+uint32_t scan_latency_percentile(uint32_t percent) {
+    uint32_t total = 0;
+    for (int i = 0; i < SCAN_LATENCY_BUCKETS; i++) total += g_scan_stats.latency_hist[i];
+    if (total == 0) return 0;
+
+    uint32_t rank = (total * percent + 99) / 100; // Decisions at or below the percentile
+    uint32_t seen = 0;
+    for (int i = 0; i < SCAN_LATENCY_BUCKETS; i++) {
+        seen += g_scan_stats.latency_hist[i];
+        if (seen >= rank) return (i + 1) * SCAN_LATENCY_BUCKET_US;
+    }
+    return SCAN_LATENCY_BUCKETS * SCAN_LATENCY_BUCKET_US;
+}
@@ -0,0 +1,359 @@
+/* Simulated fingerprint sensor
+ *
+ * Each CharBuffer and the image buffer hold "which finger" rather than real
+ * features (see sensor_sim.h). Two buffers match when they hold the same
+ * finger; SEARCH and LOADCHAR only know enrolled ones.
+ */
+
+#include "sensor_sim.h"
+#include "fingerprint.h"
+
+// ~174 us per byte at 57.6k (10 bits per byte)
+#define SENSOR_SIM_BYTE_US 174
+
+// Rough ZFM-20 figures: image capture and feature extraction dominate; a
+// search scans the library at about 1 ms per template.
+const sensor_sim_timing SENSOR_SIM_ZFM20_TIMING = {
+    150000, // getimage_us
+    280000, // image2tz_us
+    8000,   // search_base_us
+    1000,   // search_page_us
+    12000,  // loadchar_us
+    25000,  // match_us
+    5000,   // other_us
+};
+
+static bool g_active;
+static const sensor_sim_timing *g_timing;
+static uint32_t g_now_us;
+static fingerprint_parser g_parser;
+
+static uint8_t g_enrolled[(SENSOR_SIM_PAGES + 7) / 8];
+static uint16_t g_finger = SENSOR_SIM_NO_FINGER;
+static sensor_sim_finger_fn g_finger_source;
+static uint16_t g_image = SENSOR_SIM_NO_FINGER;
+static uint16_t g_charbuffer[2] = {SENSOR_SIM_NO_FINGER, SENSOR_SIM_NO_FINGER};
+
+// Pending reply: byte i is due at g_reply_due + (i + 1) * SENSOR_SIM_BYTE_US,
+// unless the line lost it or the receiver had no room for it
+static uint8_t g_reply[FINGERPRINT_MAX_PACKET];
+static bool g_reply_lost[FINGERPRINT_MAX_PACKET];
+static uint16_t g_reply_len;
+static uint16_t g_reply_pos;     // Next byte for the firmware
+static uint16_t g_reply_arrived; // Bytes that have reached the receiver
+static uint32_t g_reply_due;
+
+// Receiver (sensor_sim_rx_depth()): bytes it holds that the firmware hasn't
+// read, and how many it has lost for want of room
+static uint16_t g_rx_depth;
+static uint16_t g_rx_held;
+static uint32_t g_rx_dropped;
+
+// Line noise (sensor_sim_noise())
+static uint32_t g_ber_ppm;
+static uint32_t g_noise_rng;
+
+static bool is_enrolled(uint16_t page) {
+    return page < SENSOR_SIM_PAGES && (g_enrolled[page / 8] & (1 << (page % 8)));
+}
+
+/* sensor_sim_begin
+   Purpose: Switches the link layer from USART1 to the simulated sensor, with
+            an empty library, no finger and the clock at zero
+   Arguments:
+    timing: Command processing times, e.g. &SENSOR_SIM_ZFM20_TIMING
+   Returns: None
+*/
+void sensor_sim_begin(const sensor_sim_timing *timing) {
+    g_active = true;
+    g_timing = timing;
+    g_now_us = 0;
+    fingerprint_parser_reset(&g_parser);
+    for (unsigned int i = 0; i < sizeof(g_enrolled); i++) g_enrolled[i] = 0;
+    g_finger = g_image = SENSOR_SIM_NO_FINGER;
+    g_finger_source = NULL;
+    g_charbuffer[0] = g_charbuffer[1] = SENSOR_SIM_NO_FINGER;
+    g_reply_len = g_reply_pos = g_reply_arrived = 0;
+    g_ber_ppm = 0;
+    g_rx_depth = SERIAL_RX_RING_SIZE - 1;
+    g_rx_held = 0;
+    g_rx_dropped = 0;
+}
+
+void sensor_sim_end() {
+    g_active = false;
+}
+
+bool sensor_sim_active() {
+    return g_active;
+}
+
+// Stores a template for page_id, as STORE after an enrollment would
+void sensor_sim_enroll(uint16_t page_id) {
+    if (page_id < SENSOR_SIM_PAGES) g_enrolled[page_id / 8] |= 1 << (page_id % 8);
+}
+
+// Puts the finger enrolled at a page (or SENSOR_SIM_UNKNOWN_FINGER) on the
+// glass, or lifts it with SENSOR_SIM_NO_FINGER
+void sensor_sim_place_finger(uint16_t finger) {
+    g_finger = finger;
+}
+
+// Lets a function decide what is on the glass at each capture instead
+// (NULL to go back to sensor_sim_place_finger())
+void sensor_sim_finger_source(sensor_sim_finger_fn source) {
+    g_finger_source = source;
+}
+
+// Simulated microseconds since sensor_sim_begin()
+uint32_t sensor_sim_now_us() {
+    return g_now_us;
+}
+
+// Lets simulated time pass, standing in for a delay in the firmware
+void sensor_sim_idle(uint32_t us) {
+    g_now_us += us;
+}
+
+/* sensor_sim_rx_depth
+   Purpose: Sets how many reply bytes USART1 can hold while the firmware
+            isn't reading: 1 for the bare receive register, which overruns,
+            or the receive ring's capacity (the default, as the firmware
+            enables it). A byte that arrives with no room is lost.
+   Arguments:
+    depth: Bytes, at least 1
+   Returns: None
+*/
+void sensor_sim_rx_depth(uint16_t depth) {
+    g_rx_depth = depth ? depth : 1;
+}
+
+// Reply bytes lost since sensor_sim_begin() because the receiver was full
+uint32_t sensor_sim_rx_dropped() {
+    return g_rx_dropped;
+}
+
+/* sensor_sim_noise
+   Purpose: Makes the line noisy in both directions: each of the 10 bits of
+            a byte on the wire (start, 8 data, stop) is wrong with probability
+            ber_ppm / 1000000. A wrong data bit flips that bit; a wrong start
+            or stop bit loses the whole byte, as a framing error would.
+   Arguments:
+    ber_ppm: Bit error rate in errors per million bits, 0 for a clean line
+    seed: Nonzero seed, so a run can be repeated exactly
+   Returns: None
+*/
+void sensor_sim_noise(uint32_t ber_ppm, uint32_t seed) {
+    g_ber_ppm = ber_ppm;
+    g_noise_rng = seed;
+}
+
+// xorshift32
+static uint32_t noise_random() {
+    g_noise_rng ^= g_noise_rng << 13;
+    g_noise_rng ^= g_noise_rng >> 17;
+    g_noise_rng ^= g_noise_rng << 5;
+    return g_noise_rng;
+}
+
+/* wire
+   Purpose: Sends one byte over the (possibly noisy) line
+   Arguments:
+    byte: The byte; bits flipped by noise are flipped in place
+   Returns: false if the byte was lost
+*/
+static bool wire(uint8_t *byte) {
+    bool delivered = true;
+    if (!g_ber_ppm) return true;
+    for (int bit = 0; bit < 10; bit++) {
+        if (noise_random() % 1000000 >= g_ber_ppm) continue;
+        if (bit == 0 || bit == 9) delivered = false;
+        else *byte ^= 1 << (bit - 1);
+    }
+    return delivered;
+}
+
+/* queue_ack
+   Purpose: Queues an ACK packet to start arriving after a processing delay
+   Arguments:
+    data: Payload, confirmation code first
+    len: Length of data
+    delay_us: Processing time from now until the first byte
+   Returns: None
+*/
+static void queue_ack(const uint8_t *data, uint8_t len, uint32_t delay_us) {
+    g_reply_len = fingerprint_encode_packet(g_reply, FINGERPRINT_ACKPACKET, data, len);
+    g_reply_pos = g_reply_arrived = 0;
+    g_rx_held = 0;
+    g_reply_due = g_now_us + delay_us;
+    for (uint16_t i = 0; i < g_reply_len; i++) g_reply_lost[i] = !wire(&g_reply[i]);
+}
+
+/* execute
+   Purpose: Runs a complete command packet and queues the sensor's answer
+   Arguments:
+    cmd: The command packet; data[0] is the command byte
+   Returns: None
+*/
+static void execute(const fingerprint_packet *cmd) {
+    uint8_t ack[5] = {FINGERPRINT_OK, 0, 0, 0, 0};
+    uint8_t len = 1;
+    uint32_t delay_us = g_timing->other_us;
+    int buffer = (cmd->length > 1 && cmd->data[1] == CHARBUFFER2) ? 1 : 0;
+
+    switch (cmd->data[0]) {
+    case FINGERPRINT_GETIMAGE:
+        delay_us = g_timing->getimage_us;
+        if (g_finger_source) g_finger = g_finger_source(g_now_us);
+        g_image = g_finger;
+        if (g_finger == SENSOR_SIM_NO_FINGER) ack[0] = FINGERPRINT_NOFINGER;
+        break;
+
+    case FINGERPRINT_IMAGE2TZ:
+        delay_us = g_timing->image2tz_us;
+        g_charbuffer[buffer] = g_image;
+        if (g_image == SENSOR_SIM_NO_FINGER) ack[0] = FINGERPRINT_INVALIDIMAGE;
+        break;
+
+    case FINGERPRINT_SEARCH: {
+        if (cmd->length != 6) { // Command, BufferID, StartPage, PageNum
+            ack[0] = FINGERPRINT_PACKETRECIEVEERR;
+            break;
+        }
+        uint16_t start = (cmd->data[2] << 8) | cmd->data[3];
+        uint16_t count = (cmd->data[4] << 8) | cmd->data[5];
+        uint16_t finger = g_charbuffer[buffer];
+        uint16_t scanned = count;
+
+        ack[0] = FINGERPRINT_NOTFOUND;
+        if (finger >= start && finger - start < count && is_enrolled(finger)) {
+            scanned = finger - start + 1;
+            ack[0] = FINGERPRINT_OK;
+            ack[1] = finger >> 8; ack[2] = finger & 0xFF;
+            ack[3] = 0; ack[4] = 100; // Score
+        }
+        len = 5;
+        delay_us = g_timing->search_base_us + scanned * g_timing->search_page_us;
+        break;
+    }
+
+    case FINGERPRINT_LOADCHAR: {
+        uint16_t page = (cmd->data[2] << 8) | cmd->data[3];
+        delay_us = g_timing->loadchar_us;
+        if (cmd->length != 4) { // Command, BufferID, PageID
+            ack[0] = FINGERPRINT_PACKETRECIEVEERR;
+            delay_us = g_timing->other_us;
+        } else if (page >= SENSOR_SIM_PAGES) {
+            ack[0] = FINGERPRINT_BADLOCATION;
+        } else if (!is_enrolled(page)) {
+            ack[0] = FINGERPRINT_DBREADFAIL;
+        } else {
+            g_charbuffer[buffer] = page;
+        }
+        break;
+    }
+
+    case FINGERPRINT_MATCH:
+        delay_us = g_timing->match_us;
+        ack[0] = FINGERPRINT_NOMATCH;
+        if (g_charbuffer[0] == g_charbuffer[1] && g_charbuffer[0] != SENSOR_SIM_NO_FINGER) {
+            ack[0] = FINGERPRINT_OK;
+            ack[2] = 100; // Score
+        }
+        len = 3;
+        break;
+
+    default: // VERIFYPASSWORD and anything else just succeed
+        break;
+    }
+    queue_ack(ack, len, delay_us);
+}
+
+/* sensor_sim_tx
+   Purpose: Stands in for writing one byte to USART1
+   Arguments:
+    byte: Byte the firmware sends
+   Returns: None
+*/
+void sensor_sim_tx(uint8_t byte) {
+    g_now_us += SENSOR_SIM_BYTE_US;
+    if (!wire(&byte)) return;
+
+    // The sensor's parser is the link layer's, with its own counters so
+    // they stay out of the firmware's
+    fingerprint_link_stats sensor_stats = {};
+    int r = fingerprint_parser_feed(&g_parser, byte, &sensor_stats);
+    bool bad_checksum = sensor_stats.checksum_failures != 0;
+
+    if (r == FINGERPRINT_PARSE_COMPLETE &&
+        g_parser.packet.type == FINGERPRINT_COMMANDPACKET && g_parser.packet.length > 0) {
+        execute(&g_parser.packet);
+    } else if (bad_checksum) {
+        // The ZFM-20 answers a corrupted command packet with an error ACK
+        uint8_t ack = FINGERPRINT_PACKETRECIEVEERR;
+        queue_ack(&ack, 1, g_timing->other_us);
+    }
+}
+
+/* receive
+   Purpose: Delivers the reply bytes due by now to the receiver, which keeps
+            each one if it has room and otherwise loses it
+   Arguments: None
+   Returns: None
+*/
+static void receive() {
+    while (g_reply_arrived < g_reply_len &&
+           (int32_t)(g_reply_due + (g_reply_arrived + 1) * SENSOR_SIM_BYTE_US - g_now_us) <= 0) {
+        if (!g_reply_lost[g_reply_arrived]) {
+            if (g_rx_held < g_rx_depth) {
+                g_rx_held++;
+            } else {
+                g_reply_lost[g_reply_arrived] = true;
+                g_rx_dropped++;
+            }
+        }
+        g_reply_arrived++;
+    }
+}
+
+/* sensor_sim_rx
+   Purpose: Stands in for serial_read_timeout() on USART1
+   Arguments:
+    timeout_us: How long the caller is willing to wait
+   Returns: The next reply byte, advancing the clock to when it arrives, or
+    -1 (with the clock advanced by timeout_us) if none arrives in time
+*/
+int sensor_sim_rx(uint32_t timeout_us) {
+    receive();
+    // Lost bytes keep their time slot but never arrive
+    while (g_reply_pos < g_reply_len && g_reply_lost[g_reply_pos]) g_reply_pos++;
+    if (g_reply_pos < g_reply_arrived) {
+        g_rx_held--;
+        return g_reply[g_reply_pos++];
+    }
+    if (g_reply_pos < g_reply_len) {
+        // Waiting for it, so it is read the moment it arrives
+        uint32_t due = g_reply_due + (g_reply_pos + 1) * SENSOR_SIM_BYTE_US;
+        if ((int32_t)(due - g_now_us) <= (int32_t)timeout_us) {
+            if ((int32_t)(due - g_now_us) > 0) g_now_us = due;
+            g_reply_arrived = g_reply_pos + 1;
+            return g_reply[g_reply_pos++];
+        }
+    }
+    g_now_us += timeout_us;
+    return -1;
+}
+
+/* sensor_sim_flush
+   Purpose: Stands in for serial_flush_rx() on USART1
+   Arguments: None
+   Returns: Number of reply bytes that had already arrived and got dropped
+*/
+int sensor_sim_flush() {
+    int n = 0;
+    receive();
+    for (; g_reply_pos < g_reply_arrived; g_reply_pos++)
+        if (!g_reply_lost[g_reply_pos]) n++;
+    g_rx_held = 0;
+    return n;
+}
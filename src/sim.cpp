@@ -0,0 +1,419 @@
+/* Matching-strategy simulator
+ *
+ * Built by the "sim" PlatformIO environment in place of main.cpp. Runs the
+ * real fingerprint_match() against the simulated sensor (sensor_sim.h) with
+ * a population of enrolled users whose visits follow a Zipf distribution
+ * (user k comes by with probability proportional to 1/k^s), plus the odd
+ * unenrolled finger. s = 1 is a long tail of occasional users, s = 2 a few
+ * regulars. The same visit sequence is replayed for each size of the
+ * recently-matched list, size 0 being the plain full search. Latencies are
+ * in simulated microseconds:
+ *
+ *   sim,zipf_s,recent_size,decisions,matches,fast_hits,hit_rate_pct,avg_us,max_us
+ *   sim,1,0,2000,1897,0,0,<avg_us>,<max_us>
+ *   ...
+ *
+ * Then a queue at the door: SIM_QUEUE people (same population, s = 2) each
+ * put a finger on the glass, lift it about SIM_REACTION_US after the lock
+ * decides (or give up after SIM_PATIENCE_US), and the next person steps up
+ * about SIM_STEP_UP_US later. Each person is up to SIM_HUMAN_JITTER_US
+ * quicker or slower at both, so the queue doesn't fall into step with
+ * either loop. It runs once with the serial loop main.cpp used to
+ * have (fingerprint_match() then a 300 ms pause) and with continuous
+ * scanning (scan.h), each with USART1 as the bare receive register
+ * (rx_depth 1) and with its receive ring. Both loops print to the serial
+ * monitor as main.cpp does, at SIM_MONITOR_BYTE_US a byte, and in continuous
+ * mode the next capture's reply arrives meanwhile; rx_dropped counts the
+ * reply bytes lost because nobody read them in time. Latency is from finger
+ * down to the first decision:
+ *
+ *   scan,mode,rx_depth,people,served,gave_up,decisions,served_per_min,decisions_per_min,p50_us,p99_us,rx_dropped
+ *   scan,serial,1,...
+ *   scan,serial,255,...
+ *   scan,continuous,1,...
+ *   scan,continuous,255,...
+ *
+ * Last, link recovery on a noisy line: SIM_NOISE_SCANS scans (s = 2) at
+ * each bit error rate in g_noise_ber_ppm, with the link counters, how long
+ * a command took from its failed attempt to a valid ACK, and how many
+ * decisions still came out right. A "ber,fail" line means the counters
+ * didn't move the way the noise should have made them:
+ *
+ *   ber,ber_ppm,scans,decisions,correct,wrong,decisions_per_min,csum_fail,resync,timeout,retry,recoveries,recovery_avg_us
+ *   ber,0,...
+ *   ...
+ *   sim,done
+ */
+
+#include "ee14lib.h"
+#include "fingerprint.h"
+#include "sensor_sim.h"
+#include "scan.h"
+
+// Serial monitor print helper
+#define printf(msg) serial_write(USART2, msg, sizeof(msg) - 1)
+
+#define SIM_USERS 40
+#define SIM_DECISIONS 2000
+#define SIM_UNKNOWN_PER_100 5 // Visits by someone who isn't enrolled
+#define SIM_SEED 0x1DB0C5E5
+
+#define SIM_QUEUE 300
+#define SIM_REACTION_US 500000  // From the lock deciding to the finger lifting
+#define SIM_PATIENCE_US 4000000 // Lift anyway if nothing happened by then
+#define SIM_STEP_UP_US 600000   // Next person's finger down after a lift
+#define SIM_HUMAN_JITTER_US 200000 // Each person is up to this much faster or slower
+#define SIM_SERIAL_PAUSE_US 300000
+
+// What main.cpp prints between scans, and how long it takes at 9600 baud
+#define SIM_MONITOR_BYTE_US 1042
+#define SIM_PROMPT_BYTES 25   // "Place finger to match...", serial loop only
+#define SIM_ROTATING_BYTES 10 // "Rotating\r\n", after a match
+#define SIM_STATS_BYTES 280   // The link, match and scan lines
+#define SIM_STATS_EVERY 32    // Decisions between them
+
+#define SIM_NOISE_SCANS 1000
+static const uint32_t g_noise_ber_ppm[] = {0, 10, 100, 1000, 3000};
+
+static uint32_t g_rng;
+
+// xorshift32
+static uint32_t sim_random() {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+// Cumulative Zipf weights, 1e6/k^s for user k (integer so no float is linked)
+static uint32_t g_zipf_cdf[SIM_USERS];
+
+/* zipf_init
+   Purpose: Fills in g_zipf_cdf for exponent s
+   Arguments:
+    s: Zipf exponent, 1 or more
+   Returns: None
+*/
+static void zipf_init(int s) {
+    uint32_t sum = 0;
+    for (int k = 1; k <= SIM_USERS; k++) {
+        uint32_t weight = 1000000;
+        for (int e = 0; e < s; e++) weight /= k;
+        sum += weight ? weight : 1;
+        g_zipf_cdf[k - 1] = sum;
+    }
+}
+
+/* user_page
+   Purpose: Page the simulated user is enrolled at, spread over the library
+            so popular users don't sit next to each other
+   Arguments:
+    user: 0 (most frequent) to SIM_USERS - 1
+   Returns: Page ID
+*/
+static uint16_t user_page(int user) {
+    return (user * 73 + 11) % FINGERPRINT_LIBRARY_PAGES;
+}
+
+/* next_visitor
+   Purpose: Draws the next finger to put on the glass
+   Arguments: None
+   Returns: A page ID, or SENSOR_SIM_UNKNOWN_FINGER
+*/
+static uint16_t next_visitor() {
+    if (sim_random() % 100 < SIM_UNKNOWN_PER_100) return SENSOR_SIM_UNKNOWN_FINGER;
+
+    uint32_t r = sim_random() % g_zipf_cdf[SIM_USERS - 1];
+    int user = 0;
+    while (g_zipf_cdf[user] <= r) user++;
+    return user_page(user);
+}
+
+/* run_strategy
+   Purpose: Runs SIM_DECISIONS visits with the given recently-matched list
+            size and prints a CSV line with the hit rate and latencies
+   Arguments:
+    zipf_s: Exponent g_zipf_cdf was built with, for the output
+    recent_size: Passed to fingerprint_recent_configure()
+   Returns: None
+*/
+static void run_strategy(int zipf_s, uint8_t recent_size) {
+    uint32_t matches = 0;
+
+    sensor_sim_begin(&SENSOR_SIM_ZFM20_TIMING);
+    for (int user = 0; user < SIM_USERS; user++) sensor_sim_enroll(user_page(user));
+    fingerprint_recent_configure(recent_size);
+    g_fingerprint_match_stats = fingerprint_match_stats();
+    g_rng = SIM_SEED;
+
+    for (int i = 0; i < SIM_DECISIONS; i++) {
+        uint16_t page_id;
+        sensor_sim_place_finger(next_visitor());
+        if (fingerprint_match(&page_id)) matches++;
+    }
+    sensor_sim_end();
+
+    const fingerprint_match_stats *stats = &g_fingerprint_match_stats;
+    uint64_t total_us = stats->hit_us + stats->miss_us;
+    printf("sim,"); serial_write_uint(USART2, zipf_s);
+    printf(","); serial_write_uint(USART2, recent_size);
+    printf(","); serial_write_uint(USART2, stats->decisions);
+    printf(","); serial_write_uint(USART2, matches);
+    printf(","); serial_write_uint(USART2, stats->fast_hits);
+    printf(","); serial_write_uint(USART2, stats->fast_hits * 100 / stats->decisions);
+    printf(","); serial_write_uint(USART2, (uint32_t)(total_us / stats->decisions));
+    printf(","); serial_write_uint(USART2, stats->max_us);
+    printf("\r\n");
+}
+
+// The queue: who is next, and when each person's finger went down and
+// got a decision
+static uint16_t g_queue_finger[SIM_QUEUE];
+static uint32_t g_queue_placed_us[SIM_QUEUE];
+static uint32_t g_queue_decided_us[SIM_QUEUE];
+static uint32_t g_queue_reaction_us[SIM_QUEUE];
+static uint32_t g_queue_step_up_us[SIM_QUEUE];
+static bool g_queue_decided[SIM_QUEUE];
+static int g_queue_pos;
+static int g_queue_gave_up;
+
+// Person captured by the last two GETIMAGEs (-1 for an empty glass)
+static int g_captured_last;
+static int g_captured_prev;
+
+/* queue_finger
+   Purpose: Finger source for the simulated sensor: walks the queue forward
+            to the given time
+   Arguments:
+    now_us: Simulated time of the capture
+   Returns: Finger on the glass, or SENSOR_SIM_NO_FINGER
+*/
+static uint16_t queue_finger(uint32_t now_us) {
+    int on_glass = -1;
+
+    while (g_queue_pos < SIM_QUEUE) {
+        int p = g_queue_pos;
+        uint32_t placed = g_queue_placed_us[p];
+        if ((int32_t)(now_us - placed) < 0) break; // Not down yet
+
+        uint32_t lift = g_queue_decided[p] ? g_queue_decided_us[p] + g_queue_reaction_us[p]
+                                           : placed + SIM_PATIENCE_US;
+        if ((int32_t)(now_us - lift) < 0) {
+            on_glass = p;
+            break;
+        }
+        if (!g_queue_decided[p]) g_queue_gave_up++;
+        if (++g_queue_pos < SIM_QUEUE)
+            g_queue_placed_us[g_queue_pos] = lift + g_queue_step_up_us[g_queue_pos];
+    }
+
+    g_captured_prev = g_captured_last;
+    g_captured_last = on_glass;
+    return on_glass < 0 ? SENSOR_SIM_NO_FINGER : g_queue_finger[on_glass];
+}
+
+/* monitor_write
+   Purpose: Lets the time pass that printing to the serial monitor takes
+   Arguments:
+    bytes: Bytes printed
+   Returns: None
+*/
+static void monitor_write(uint32_t bytes) {
+    sensor_sim_idle(bytes * SIM_MONITOR_BYTE_US);
+}
+
+/* run_queue
+   Purpose: Runs the whole queue through one scanning loop and prints a CSV
+            line with throughput and finger-down-to-decision latency
+   Arguments:
+    continuous: true for scan_step(), false for the serial loop
+    rx_depth: Reply bytes USART1 holds unread (sensor_sim_rx_depth())
+   Returns: None
+*/
+static void run_queue(bool continuous, uint16_t rx_depth) {
+    static uint32_t latency_us[SIM_QUEUE];
+    uint32_t served = 0;
+    uint32_t decisions = 0;
+
+    sensor_sim_begin(&SENSOR_SIM_ZFM20_TIMING);
+    sensor_sim_rx_depth(rx_depth);
+    for (int user = 0; user < SIM_USERS; user++) sensor_sim_enroll(user_page(user));
+    fingerprint_recent_configure(FINGERPRINT_RECENT_SIZE);
+    g_fingerprint_match_stats = fingerprint_match_stats();
+    g_rng = SIM_SEED;
+
+    for (int p = 0; p < SIM_QUEUE; p++) {
+        uint16_t finger = next_visitor();
+        // Strangers are all different people
+        g_queue_finger[p] = finger == SENSOR_SIM_UNKNOWN_FINGER ? SENSOR_SIM_PAGES + p : finger;
+        g_queue_decided[p] = false;
+        g_queue_reaction_us[p] = SIM_REACTION_US - SIM_HUMAN_JITTER_US
+                                 + sim_random() % (2 * SIM_HUMAN_JITTER_US + 1);
+        g_queue_step_up_us[p] = SIM_STEP_UP_US - SIM_HUMAN_JITTER_US
+                                + sim_random() % (2 * SIM_HUMAN_JITTER_US + 1);
+    }
+    g_queue_pos = 0;
+    g_queue_gave_up = 0;
+    g_queue_placed_us[0] = g_queue_step_up_us[0];
+    g_captured_last = g_captured_prev = -1;
+    sensor_sim_finger_source(queue_finger);
+
+    if (continuous) scan_begin();
+    while (g_queue_pos < SIM_QUEUE) {
+        bool decided;
+        bool matched;
+        int person;
+
+        if (continuous) {
+            scan_result result;
+            scan_step(&result);
+            decided = result.outcome == SCAN_MATCHED || result.outcome == SCAN_REJECTED;
+            matched = result.matched && decided;
+            person = g_captured_prev; // The next capture has already started
+        } else {
+            uint16_t page_id;
+            uint32_t before = g_fingerprint_match_stats.decisions;
+            monitor_write(SIM_PROMPT_BYTES);
+            matched = fingerprint_match(&page_id);
+            decided = g_fingerprint_match_stats.decisions != before;
+            person = g_captured_last;
+        }
+
+        if (decided) {
+            decisions++;
+            if (person >= 0 && !g_queue_decided[person]) {
+                g_queue_decided[person] = true;
+                g_queue_decided_us[person] = sensor_sim_now_us();
+                latency_us[served++] = sensor_sim_now_us() - g_queue_placed_us[person];
+            }
+            // main.cpp's output, while the next capture runs in continuous mode
+            if (matched) monitor_write(SIM_ROTATING_BYTES);
+            if (decisions % SIM_STATS_EVERY == 0) monitor_write(SIM_STATS_BYTES);
+        }
+        if (!continuous) sensor_sim_idle(SIM_SERIAL_PAUSE_US);
+    }
+    if (continuous) scan_end();
+    uint32_t elapsed_us = sensor_sim_now_us();
+    uint32_t rx_dropped = sensor_sim_rx_dropped();
+    sensor_sim_end();
+
+    // Insertion sort for the percentiles; the queue is short
+    for (uint32_t i = 1; i < served; i++) {
+        uint32_t v = latency_us[i];
+        uint32_t j = i;
+        for (; j > 0 && latency_us[j - 1] > v; j--) latency_us[j] = latency_us[j - 1];
+        latency_us[j] = v;
+    }
+
+    if (continuous) printf("scan,continuous,");
+    else printf("scan,serial,");
+    serial_write_uint(USART2, rx_depth);
+    printf(","); serial_write_uint(USART2, SIM_QUEUE);
+    printf(","); serial_write_uint(USART2, served);
+    printf(","); serial_write_uint(USART2, g_queue_gave_up);
+    printf(","); serial_write_uint(USART2, decisions);
+    printf(","); serial_write_uint(USART2, (uint32_t)((uint64_t)served * 60000000 / elapsed_us));
+    printf(","); serial_write_uint(USART2, (uint32_t)((uint64_t)decisions * 60000000 / elapsed_us));
+    printf(","); serial_write_uint(USART2, served ? latency_us[(served - 1) / 2] : 0);
+    printf(","); serial_write_uint(USART2, served ? latency_us[(served * 99 + 99) / 100 - 1] : 0);
+    printf(","); serial_write_uint(USART2, rx_dropped);
+    printf("\r\n");
+}
+
+/* run_noise
+   Purpose: Runs SIM_NOISE_SCANS scans over a line with the given bit error
+            rate and prints a CSV line with the link counters, recovery time
+            and decision rate, plus a "ber,fail" line if the counters
+            disagree with the noise
+   Arguments:
+    ber_ppm: Bit errors per million bits, in both directions
+   Returns: None
+*/
+static void run_noise(uint32_t ber_ppm) {
+    uint32_t correct = 0;
+    uint32_t wrong = 0;
+    uint64_t elapsed_us = 0; // The simulated clock wraps after 71 minutes
+
+    sensor_sim_begin(&SENSOR_SIM_ZFM20_TIMING);
+    for (int user = 0; user < SIM_USERS; user++) sensor_sim_enroll(user_page(user));
+    sensor_sim_noise(ber_ppm, SIM_SEED);
+    fingerprint_recent_configure(FINGERPRINT_RECENT_SIZE);
+    g_fingerprint_match_stats = fingerprint_match_stats();
+    g_fingerprint_stats = fingerprint_link_stats();
+    g_rng = SIM_SEED;
+
+    for (int i = 0; i < SIM_NOISE_SCANS; i++) {
+        uint16_t finger = next_visitor();
+        uint16_t page_id;
+        uint32_t decisions = g_fingerprint_match_stats.decisions;
+        uint32_t start_us = sensor_sim_now_us();
+
+        sensor_sim_place_finger(finger);
+        bool matched = fingerprint_match(&page_id);
+        elapsed_us += sensor_sim_now_us() - start_us;
+        if (g_fingerprint_match_stats.decisions != decisions) {
+            if (finger == SENSOR_SIM_UNKNOWN_FINGER ? !matched : matched && page_id == finger)
+                correct++;
+            else if (matched)
+                wrong++; // Opened for the wrong person
+        }
+    }
+    sensor_sim_end();
+
+    const fingerprint_link_stats *link = &g_fingerprint_stats;
+    uint32_t decisions = g_fingerprint_match_stats.decisions;
+    printf("ber,"); serial_write_uint(USART2, ber_ppm);
+    printf(","); serial_write_uint(USART2, SIM_NOISE_SCANS);
+    printf(","); serial_write_uint(USART2, decisions);
+    printf(","); serial_write_uint(USART2, correct);
+    printf(","); serial_write_uint(USART2, wrong);
+    printf(","); serial_write_uint(USART2, (uint32_t)(decisions * 60000000ULL / elapsed_us));
+    printf(","); serial_write_uint(USART2, link->checksum_failures);
+    printf(","); serial_write_uint(USART2, link->resyncs);
+    printf(","); serial_write_uint(USART2, link->timeouts);
+    printf(","); serial_write_uint(USART2, link->retries);
+    printf(","); serial_write_uint(USART2, link->recoveries);
+    printf(","); serial_write_uint(USART2, link->recoveries ? (uint32_t)(link->recovery_us / link->recoveries) : 0);
+    printf("\r\n");
+
+    // A clean line must need no recovery; a noisy one must show it
+    uint32_t moved = link->checksum_failures + link->resyncs + link->timeouts + link->retries;
+    if (ber_ppm == 0 ? moved != 0 : moved == 0 || link->recoveries == 0) {
+        printf("ber,fail,"); serial_write_uint(USART2, ber_ppm);
+        printf("\r\n");
+    }
+}
+
+/* Simulator driver
+   Purpose: Compares every list size from 0 (full search only) up, for
+            both user populations, then the serial and continuous scan
+            loops, then link recovery at each bit error rate
+   Arguments: None
+   Returns: None--results are on the serial monitor
+*/
+int main() {
+    host_serial_init();
+
+    printf("sim,zipf_s,recent_size,decisions,matches,fast_hits,hit_rate_pct,avg_us,max_us\r\n");
+    for (int s = 1; s <= 2; s++) {
+        zipf_init(s);
+        for (uint8_t size = 0; size <= FINGERPRINT_RECENT_SIZE; size++) run_strategy(s, size);
+    }
+
+    printf("scan,mode,rx_depth,people,served,gave_up,decisions,served_per_min,decisions_per_min,p50_us,p99_us,rx_dropped\r\n");
+    for (int continuous = 0; continuous <= 1; continuous++) {
+        run_queue(continuous, 1);                       // Receive register only
+        run_queue(continuous, SERIAL_RX_RING_SIZE - 1); // Receive ring
+    }
+
+    printf("ber,ber_ppm,scans,decisions,correct,wrong,decisions_per_min,csum_fail,resync,timeout,retry,recoveries,recovery_avg_us\r\n");
+    for (unsigned int i = 0; i < sizeof(g_noise_ber_ppm) / sizeof(g_noise_ber_ppm[0]); i++)
+        run_noise(g_noise_ber_ppm[i]);
+    printf("sim,done\r\n");
+
+#ifdef EE14LIB_HOST
+    return 0;
+#endif
+    while (1)
+        ;
+}
@@ -0,0 +1,145 @@
+#include "swtimer.h"
+
+#define SWTIMER_SLOT_MASK (SWTIMER_WHEEL_SLOTS - 1)
+
+// Each slot is a circular list with a sentinel head. A timer that isn't in
+// any list has next == NULL, so zero-initialized statics start out disarmed.
+static swtimer g_wheel[SWTIMER_WHEEL_SLOTS];
+
+static volatile uint32_t g_ticks;  // Advanced by the TIM16 interrupt
+static uint32_t g_wheel_tick;      // Last tick the PendSV handler has processed
+
+static void list_init(swtimer *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static void list_insert(swtimer *head, swtimer *timer) {
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static void list_remove(swtimer *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+// Start TIM16 ticking every SWTIMER_TICK_MS and set up the wheel. PendSV gets
+// the lowest priority so that callbacks run after every real interrupt.
+// Always returns EE14Lib_Err_OK; in the future this may return errors for
+// invalid configurations.
+EE14Lib_Err swtimer_init()
+{
+    extern uint32_t SystemCoreClock;
+
+    for (int i = 0; i < SWTIMER_WHEEL_SLOTS; i++) list_init(&g_wheel[i]);
+    g_ticks = 0;
+    g_wheel_tick = 0;
+
+    RCC->APB2ENR |= RCC_APB2ENR_TIM16EN;
+
+    // Count at 1 MHz, overflow once per tick
+    TIM16->PSC = SystemCoreClock / 1000000 - 1;
+    TIM16->ARR = 1000 * SWTIMER_TICK_MS - 1;
+    TIM16->EGR = TIM_EGR_UG;   // Load PSC now rather than at the first overflow
+    TIM16->SR = 0;             // ...and drop the update flag that just set
+    TIM16->DIER |= TIM_DIER_UIE;
+
+    NVIC_SetPriority(PendSV_IRQn, (1UL << __NVIC_PRIO_BITS) - 1);
+    NVIC_SetPriority(TIM1_UP_TIM16_IRQn, 1);
+    NVIC_EnableIRQ(TIM1_UP_TIM16_IRQn);
+
+    TIM16->CR1 |= TIM_CR1_CEN;
+    return EE14Lib_Err_OK;
+}
+
+// Arm a timer, replacing any earlier schedule it had.
+//   timer: Caller-owned timer, must stay valid while armed
+//   delay_ms: Time until the first call (rounded up to at least one tick)
+//   period_ms: Time between later calls, or 0 for a one-shot timer
+//   callback: Called from the PendSV handler when the timer expires
+//   arg: Passed to callback
+void swtimer_arm(swtimer *timer, uint32_t delay_ms, uint32_t period_ms,
+                 swtimer_callback callback, void *arg)
+{
+    uint32_t delay = (delay_ms + SWTIMER_TICK_MS - 1) / SWTIMER_TICK_MS;
+    if (delay == 0) delay = 1;
+
+    // The PendSV handler walks these lists, so keep it out while we edit them
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (timer->next) list_remove(timer);
+    timer->expires = g_ticks + delay;
+    timer->period = (period_ms + SWTIMER_TICK_MS - 1) / SWTIMER_TICK_MS;
+    timer->callback = callback;
+    timer->arg = arg;
+    list_insert(&g_wheel[timer->expires & SWTIMER_SLOT_MASK], timer);
+    __set_PRIMASK(primask);
+}
+
+// Stop a timer. Harmless if it isn't armed; once this returns its callback
+// will not run (unless it is already running).
+void swtimer_cancel(swtimer *timer)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (timer->next) list_remove(timer);
+    __set_PRIMASK(primask);
+}
+
+// Whether the timer is waiting to fire
+bool swtimer_armed(const swtimer *timer)
+{
+    return timer->next != NULL;
+}
+
+// Milliseconds since swtimer_init(), in steps of SWTIMER_TICK_MS
+uint32_t swtimer_now_ms()
+{
+    return g_ticks * SWTIMER_TICK_MS;
+}
+
+extern "C" void TIM1_UP_TIM16_IRQHandler()
+{
+    if (TIM16->SR & TIM_SR_UIF) {
+        TIM16->SR = ~TIM_SR_UIF;
+        g_ticks++;
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk; // Run the wheel once we're out of here
+    }
+}
+
+// Process every tick since the last run. Timers due on a tick are first
+// moved to a private list and only then called, so callbacks can freely arm
+// or cancel timers (including ones still waiting in that list).
+extern "C" void PendSV_Handler()
+{
+    while (g_wheel_tick != g_ticks) {
+        uint32_t tick = ++g_wheel_tick;
+        swtimer *slot = &g_wheel[tick & SWTIMER_SLOT_MASK];
+        swtimer expired;
+
+        list_init(&expired);
+        for (swtimer *t = slot->next; t != slot; ) {
+            swtimer *next = t->next;
+            if (t->expires == tick) {
+                list_remove(t);
+                list_insert(&expired, t);
+            }
+            t = next;
+        }
+
+        while (expired.next != &expired) {
+            swtimer *t = expired.next;
+            list_remove(t);
+            if (t->period) {
+                t->expires += t->period; // Measured from the due tick, so no drift
+                list_insert(&g_wheel[t->expires & SWTIMER_SLOT_MASK], t);
+            }
+            t->callback(t->arg);
+        }
+    }
+}
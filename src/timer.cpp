@@ -94,6 +94,23 @@ int g_Timer16Channel[D13 + 1] = {
     -1, -1          // D12=PB4,D13=PB3.
 };
 
+// Convert a 0-1023 duty cycle into a CCR compare value for a timer whose
+// period is arr+1 counts.
+// With EE14LIB_NO_FLOAT this is exact integer math, rounded to nearest:
+// splitting (arr+1) into 1023*q + r keeps every product within 32 bits for
+// any ARR, so neither soft-float nor 64-bit division helpers get linked.
+static unsigned int timer_duty_to_ccr(unsigned int duty, uint32_t arr)
+{
+#ifdef EE14LIB_NO_FLOAT
+    uint32_t period = arr + 1;
+    uint32_t q = period / 1023;
+    uint32_t r = period % 1023;
+    return duty * q + (duty * r + 511) / 1023;
+#else
+    return (unsigned)((duty / 1023.0f) * (arr + 1));
+#endif
+}
+
 void timer_set_pwm_duty(TIM_TypeDef *timer, EE14Lib_Pin pin, unsigned int duty_0_to_1023) {
     int channel = -1;
     if (timer == TIM1)
@@ -111,9 +128,7 @@ void timer_set_pwm_duty(TIM_TypeDef *timer, EE14Lib_Pin pin, unsigned int duty_0
     int channel_idx = channel >> 1; // (0,1,2,3)
 
     // Scale correctly from 0-1023 to ARR value
-    unsigned int ccr_value = (unsigned)((duty_0_to_1023 / 1023.0f) * (timer->ARR + 1));
-
-    *((unsigned int *)timer + 13 + channel_idx) = ccr_value;
+    *((unsigned int *)timer + 13 + channel_idx) = timer_duty_to_ccr(duty_0_to_1023, timer->ARR);
 }
 
 
@@ -162,7 +177,7 @@ EE14Lib_Err timer_config_channel_pwm(TIM_TypeDef *const timer, const EE14Lib_Pin
     // Timer CCR registers are 0x34 through 0x40
     // Divides the duty value by the range (1023) and multiplies that %
     // by the ARR value
-    *((unsigned int *)timer + 13 + channel_idx) = (unsigned)((duty / 1023.0f) * (timer->ARR + 1));
+    *((unsigned int *)timer + 13 + channel_idx) = timer_duty_to_ccr(duty, timer->ARR);
 
     // Enable PWM mode, and set preload enable (only update counter on rollover)
     if (channel_idx == 0)
@@ -204,3 +219,20 @@ EE14Lib_Err timer_config_channel_pwm(TIM_TypeDef *const timer, const EE14Lib_Pin
 
     return EE14Lib_Err_OK;
 }
+
+
+// Start the Cortex-M4 DWT cycle counter. It counts core clock cycles and is
+// the cheapest way to time short stretches of code.
+void cycle_counter_init()
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // Enable the trace/debug blocks
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// Read the cycle counter. Subtract two readings (as uint32_t) for the elapsed
+// cycles; the subtraction is correct across one wraparound.
+uint32_t cycle_counter_read()
+{
+    return DWT->CYCCNT;
+}
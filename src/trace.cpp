@@ -0,0 +1,279 @@
+/* USART1 traffic capture and replay
+ *
+ * trace_now_us() and replay timing come from the DWT cycle counter, so
+ * cycle_counter_init() must run first. Capture is timed by whatever clock
+ * the link layer passes in, so a capture against the simulated sensor
+ * carries the simulated timing.
+ */
+
+#include "trace.h"
+#include "checksum.h"
+
+extern uint32_t SystemCoreClock;
+
+// Capture state
+static uint8_t g_trace[TRACE_BUFFER_SIZE];
+static uint32_t g_trace_len;
+static uint32_t g_trace_dropped;
+static bool g_recording;
+static uint32_t g_last_us;     // When the previous entry was recorded
+static bool g_have_last;      // An entry was recorded since trace_start()
+
+#ifdef FINGERPRINT_REPLAY
+// Replay state
+static const uint8_t *g_replay;
+static uint32_t g_replay_len;
+static uint32_t g_replay_pos;
+static uint32_t g_replay_mismatches;
+static uint32_t g_anchor_cycles; // When the previous entry happened in this run
+#endif
+
+// Monotonic microsecond clock
+static uint32_t g_now_us;
+static uint32_t g_now_cycles;
+
+#ifdef FINGERPRINT_REPLAY
+typedef struct {
+    uint8_t direction;
+    uint8_t byte;
+    uint32_t delta_us;
+    uint32_t size; // Encoded length of the entry
+} trace_entry;
+#endif
+
+static uint32_t cycles_per_us() {
+    uint32_t c = SystemCoreClock / 1000000;
+    return c ? c : 1;
+}
+
+/* trace_now_us
+   Purpose: Microseconds since the first call, from the cycle counter.
+            Must be called at least once per counter wrap to stay monotonic.
+   Arguments: None
+   Returns: Elapsed microseconds
+*/
+uint32_t trace_now_us() {
+    uint32_t elapsed_us = (cycle_counter_read() - g_now_cycles) / cycles_per_us();
+    g_now_cycles += elapsed_us * cycles_per_us();
+    g_now_us += elapsed_us;
+    return g_now_us;
+}
+
+/* trace_start
+   Purpose: Clears the capture buffer and starts recording
+   Arguments: None
+   Returns: None
+*/
+void trace_start() {
+    g_trace_len = 0;
+    g_trace_dropped = 0;
+    g_have_last = false;
+    g_recording = true;
+}
+
+/* trace_stop
+   Purpose: Stops recording; the buffer is kept until the next dump or start
+   Arguments: None
+   Returns: None
+*/
+void trace_stop() {
+    g_recording = false;
+}
+
+/* trace_record
+   Purpose: Appends one byte to the capture, if recording. The first entry
+            after trace_start() gets a delta of 0.
+   Arguments:
+    direction: TRACE_TX or TRACE_RX
+    byte: Byte on the wire
+    now_us: The link layer's clock (trace_now_us(), or simulated time when
+     talking to the simulated sensor)
+   Returns: None
+*/
+void trace_record(uint8_t direction, uint8_t byte, uint32_t now_us) {
+    if (!g_recording) return;
+    if (g_trace_len + 6 > TRACE_BUFFER_SIZE) { // Longest varint is 5 bytes
+        g_trace_dropped++;
+        return;
+    }
+
+    uint32_t delta_us = g_have_last ? now_us - g_last_us : 0;
+    g_last_us = now_us;
+    g_have_last = true;
+    if (delta_us > 0x7FFFFFFF) delta_us = 0x7FFFFFFF;
+
+    uint32_t value = (delta_us << 1) | direction;
+    while (value >= 0x80) {
+        g_trace[g_trace_len++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    g_trace[g_trace_len++] = value;
+    g_trace[g_trace_len++] = byte;
+}
+
+/* trace_dump
+   Purpose: Drains the capture over a UART as hex text and empties the
+            buffer (recording continues if it was on). Output format:
+              trace,begin
+              trace,<up to 32 bytes as hex>
+              ...
+              trace,end,<bytes>,<dropped entries>,<CRC-32 of the bytes, hex>
+   Arguments:
+    USARTx: UART to write to, normally USART2 (serial monitor)
+   Returns: None
+*/
+void trace_dump(USART_TypeDef *USARTx) {
+    const char hex_digits[] = "0123456789ABCDEF";
+
+    serial_write(USARTx, "trace,begin\r\n", 13);
+    for (uint32_t i = 0; i < g_trace_len; i += 32) {
+        char line[6 + 64 + 2] = {'t', 'r', 'a', 'c', 'e', ','};
+        int len = 6;
+        for (uint32_t j = i; j < i + 32 && j < g_trace_len; j++) {
+            line[len++] = hex_digits[g_trace[j] >> 4];
+            line[len++] = hex_digits[g_trace[j] & 0x0F];
+        }
+        line[len++] = '\r';
+        line[len++] = '\n';
+        serial_write(USARTx, line, len);
+    }
+    serial_write(USARTx, "trace,end,", 10);
+    serial_write_uint(USARTx, g_trace_len);
+    serial_write(USARTx, ",", 1);
+    serial_write_uint(USARTx, g_trace_dropped);
+
+    // Lets the host tell a trace mangled on the serial monitor from a real one
+    uint32_t crc = checksum_crc32(g_trace, g_trace_len);
+    char crc_hex[9] = {','};
+    for (int i = 0; i < 8; i++) crc_hex[1 + i] = hex_digits[(crc >> (28 - 4 * i)) & 0x0F];
+    serial_write(USARTx, crc_hex, 9);
+    serial_write(USARTx, "\r\n", 2);
+
+    g_trace_len = 0;
+    g_trace_dropped = 0;
+}
+
+#ifdef FINGERPRINT_REPLAY
+/* peek_entry
+   Purpose: Decodes the next replay entry without consuming it
+   Arguments:
+    entry: Filled in with the decoded entry
+   Returns: false at the end of the trace (or on a truncated entry)
+*/
+static bool peek_entry(trace_entry *entry) {
+    uint32_t pos = g_replay_pos;
+    uint32_t value = 0;
+    int shift = 0;
+
+    while (pos < g_replay_len && shift < 35) {
+        uint8_t b = g_replay[pos++];
+        value |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+        if (!(b & 0x80)) {
+            if (pos >= g_replay_len) return false;
+            entry->direction = value & 1;
+            entry->delta_us = value >> 1;
+            entry->byte = g_replay[pos++];
+            entry->size = pos - g_replay_pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* trace_replay_begin
+   Purpose: Switches the link layer from USART1 to a captured trace
+   Arguments:
+    trace: Trace bytes, as produced by trace_dump()
+    len: Length of trace
+   Returns: None
+*/
+void trace_replay_begin(const uint8_t *trace, uint32_t len) {
+    g_replay = trace;
+    g_replay_len = len;
+    g_replay_pos = 0;
+    g_replay_mismatches = 0;
+    g_anchor_cycles = cycle_counter_read();
+}
+
+bool trace_replay_done() {
+    trace_entry entry;
+    return !peek_entry(&entry);
+}
+
+// TX bytes that differed from (or went beyond) the trace
+uint32_t trace_replay_mismatches() {
+    return g_replay_mismatches;
+}
+
+/* trace_replay_tx
+   Purpose: Checks a byte the firmware sends against the trace. Replies in
+            the trace are timed from here, so a slower or faster firmware
+            shows up as a different end-to-end latency.
+   Arguments:
+    byte: Byte the firmware would have put on USART1
+   Returns: None
+*/
+void trace_replay_tx(uint8_t byte) {
+    trace_entry entry;
+
+    // Replies the firmware never read are skipped, as USART1 would drop them
+    while (peek_entry(&entry) && entry.direction == TRACE_RX)
+        g_replay_pos += entry.size;
+
+    if (!peek_entry(&entry)) {
+        g_replay_mismatches++;
+        return;
+    }
+    if (entry.byte != byte) g_replay_mismatches++;
+    g_replay_pos += entry.size;
+    g_anchor_cycles = cycle_counter_read();
+}
+
+/* trace_replay_rx
+   Purpose: Stands in for serial_read_timeout() on USART1 during replay
+   Arguments:
+    timeout_us: How long the caller is willing to wait
+   Returns: The next received byte once its recorded time has come, or -1 if
+    the trace has no reply within timeout_us (after waiting that long)
+*/
+int trace_replay_rx(uint32_t timeout_us) {
+    trace_entry entry;
+    uint32_t start = cycle_counter_read();
+    uint32_t timeout_cycles = timeout_us * cycles_per_us();
+
+    if (peek_entry(&entry) && entry.direction == TRACE_RX) {
+        uint32_t due = g_anchor_cycles + entry.delta_us * cycles_per_us();
+        if ((int32_t)(due - start) <= (int32_t)timeout_cycles) {
+            while ((int32_t)(cycle_counter_read() - due) < 0)
+                ;
+            g_replay_pos += entry.size;
+            g_anchor_cycles = due;
+            return entry.byte;
+        }
+    }
+
+    while (cycle_counter_read() - start < timeout_cycles)
+        ;
+    return -1;
+}
+
+/* trace_replay_flush
+   Purpose: Stands in for serial_flush_rx() on USART1 during replay
+   Arguments: None
+   Returns: Number of received bytes that were already due and got dropped
+*/
+int trace_replay_flush() {
+    trace_entry entry;
+    int n = 0;
+
+    while (peek_entry(&entry) && entry.direction == TRACE_RX) {
+        uint32_t due = g_anchor_cycles + entry.delta_us * cycles_per_us();
+        if ((int32_t)(cycle_counter_read() - due) < 0) break;
+        g_replay_pos += entry.size;
+        g_anchor_cycles = due;
+        n++;
+    }
+    return n;
+}
+#endif
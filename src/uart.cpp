@@ -8,39 +8,15 @@
 #include "stm32l432xx.h"
 #include <stdbool.h>
 #include "ee14lib.h"
+#include "board.h"
 
 
 
-// The Nucleo 432 wires PA2 to the ST-Link's VCP_TX pin via AF7, and PA3 to
-// VCP_RX via AF7.
-// In this function, we set up those pins.
-// The alternate-function designation presumably sets most on the GPIO pin's
-// internals. However, we still set them here to high-speed, pullup-only,
-// push-pull drive.
-// MODIFIED: Enables USART1 and USART2
-static void UART2_GPIO_Init(void) {
-        set_gpio_alt_func(GPIOA, 2, 7);  // USART2_TX
-        set_gpio_alt_func(GPIOA, 3, 7);  // USART2_RX
-    
-        GPIOA->OSPEEDR |= 0x3<<(2*2) | 0x3<<(2*3);      // Very high speed
-        GPIOA->PUPDR   &= ~((0x3<<(2*2)) | (0x3<<(2*3)));
-        GPIOA->PUPDR   |=   (0x1<<(2*2)) | (0x1<<(2*3)); // Pull-up
-        GPIOA->OTYPER  &= ~((0x3<<(2*2)) | (0x3<<(2*3))); // Push-pull
-    
-        // --- USART1 (PA9 = TX, PA10 = RX) ---
-        set_gpio_alt_func(GPIOA, 9, 7);  // USART1_TX (D1)
-        set_gpio_alt_func(GPIOA,10, 7);  // USART1_RX (D0)
-    
-        GPIOA->OSPEEDR |= 0x3<<(2*9) | 0x3<<(2*10);      // Very high speed
-        GPIOA->PUPDR   &= ~((0x3<<(2*9)) | (0x3<<(2*10)));
-        GPIOA->PUPDR   |=   (0x1<<(2*9)) | (0x1<<(2*10)); // Pull-up
-        GPIOA->OTYPER  &= ~((0x3<<(2*9)) | (0x3<<(2*10))); // Push-pull
-}
-
-
 // Set for 8 data bits, 1 start & 1 stop bit, 16x oversampling, 9600 baud.
 // And by default, we also get no parity, no hardware flow control (USART_CR3),
 // asynch mode (USART_CR2).
+// This doesn't wait for the USART to come up; call USART_Wait_Ready() after
+// configuring every port, so their start-up times overlap.
 static void USART_Init (USART_TypeDef *USARTx, bool tx_en, bool rx_en,int baud){
     // Disable the USART.
     USARTx->CR1 &= ~USART_CR1_UE;  // Disable USART
@@ -77,7 +53,10 @@ static void USART_Init (USART_TypeDef *USARTx, bool tx_en, bool rx_en,int baud){
     // We originally turned off the USART -- now turn it back on.
     // Note that page 1202 says to turn this on *before* asserting TE and/or RE.
     USARTx->CR1  |= USART_CR1_UE; // USART enable                 
-	
+}
+
+// Wait until a USART started by USART_Init() is actually up.
+static void USART_Wait_Ready (USART_TypeDef *USARTx, bool tx_en, bool rx_en){
     // Verify that the USART is ready to transmit...
     if (tx_en)
 	while ( (USARTx->ISR & USART_ISR_TEACK) == 0)
@@ -149,39 +128,36 @@ void set_gpio_alt_func (GPIO_TypeDef *gpio, unsigned int pin, unsigned int func)
     gpio->PUPDR &= ~(3UL <<(2*pin));		// No PUP or PDN
 }
 
-// MODIFIED: Initializes USART1 and USART2
-void host_serial_init() {
+// Start USART2 (serial monitor, 9600 baud) and USART1 (fingerprint sensor,
+// 57600 baud). Their clocks and pins must already be set up, e.g. by
+// board_apply(); host_serial_init() does both.
+void serial_start() {
     int baud=9600;
     int fingerprint_baud = 57600;
 
-    // Enable USART 2 clock
-    RCC->APB1ENR1 |= RCC_APB1ENR1_USART2EN;  
-
-    // Enable USART1 clock
-    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
-
-    // Select SYSCLK as the USART2 clock source. The reset default is PCLK1;
-    // we usually set both SYSCLK and PCLK1 to 80MHz anyway.
-    RCC->CCIPR &= ~RCC_CCIPR_USART2SEL;
-    RCC->CCIPR |=  RCC_CCIPR_USART2SEL_0;
+    // Select SYSCLK as the clock source for both USARTs, in one write. The
+    // reset default is PCLK; we usually set both SYSCLK and PCLK to 80MHz anyway.
+    RCC->CCIPR = (RCC->CCIPR & ~(RCC_CCIPR_USART1SEL | RCC_CCIPR_USART2SEL))
+	       | RCC_CCIPR_USART1SEL_0 | RCC_CCIPR_USART2SEL_0;
 
-    // Select SYSCLK as USART1 clock srouce
-    RCC->CCIPR &= ~RCC_CCIPR_USART1SEL;   
-    RCC->CCIPR |=  RCC_CCIPR_USART1SEL_0; 
-
-    // Set alternate function for PA9 = TX (AF7), PA10 = RX (AF7)
-    set_gpio_alt_func(GPIOA, 9, 7);   // USART1_TX
-    set_gpio_alt_func(GPIOA, 10, 7);  // USART1_RX
+    USART_Init (USART2, 1, 1, baud);	// Set 9600 for serial montior USART
+    USART_Init (USART1, 1, 1, fingerprint_baud); // Set fingerprint USART baud rate to 57600
 
-     // Pull-up on both PA9, PA10 (01)
-     GPIOA->PUPDR &= ~((0x3 << (2 * 9)) | (0x3 << (2 * 10)));
-     GPIOA->PUPDR |=  (0x1 << (2 * 9)) | (0x1 << (2 * 10));
+    // Both ports are starting up at the same time; wait for them together
+    USART_Wait_Ready (USART2, 1, 1);
+    USART_Wait_Ready (USART1, 1, 1);
+}
 
-    // Connect the I/O pins to the serial peripheral
-    UART2_GPIO_Init();
+// The serial pins and clocks on their own, for programs that don't use the
+// rest of the lockbox board (see board.h).
+static constexpr board_pin g_serial_pins[] = {BOARD_SERIAL_PINS};
+static constexpr board_config g_serial_board =
+    board_compile(g_serial_pins, BOARD_SERIAL_APB1ENR1, BOARD_SERIAL_APB2ENR);
 
-    USART_Init (USART2, 1, 1, baud);	// Set 9600 for serial montior USART
-    USART_Init (USART1, 1, 1, fingerprint_baud); // Set fingerprint USART baud rate to 57600
+// MODIFIED: Initializes USART1 and USART2
+void host_serial_init() {
+    board_apply(&g_serial_board);
+    serial_start();
 }
 
 // Very basic function: send a character string to the UART, one byte at a time.
@@ -210,3 +186,151 @@ char serial_read (USART_TypeDef *USARTx) {
     return ((char)(USARTx->RDR & 0xFF));
 }
 
+
+// Clear any receive error flags (overrun, framing, noise, parity). An overrun
+// in particular must be cleared before the receiver will latch another byte.
+static void serial_clear_rx_errors (USART_TypeDef *USARTx) {
+    if (USARTx->ISR & (USART_ISR_ORE | USART_ISR_FE | USART_ISR_NE | USART_ISR_PE))
+	USARTx->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_PECF;
+}
+
+// Receive ring for one USART, filled by its RXNE interrupt once
+// serial_rx_interrupt_enable() has been called. Without it the receiver only
+// holds one byte, and anything arriving while the program is busy elsewhere
+// overruns it.
+typedef struct {
+    volatile uint8_t data[SERIAL_RX_RING_SIZE];
+    volatile uint16_t head;	// Next slot the interrupt fills
+    volatile uint16_t tail;	// Next byte to hand out
+    volatile uint32_t dropped;	// Bytes lost to a full ring or an overrun
+    bool enabled;
+} serial_rx_ring;
+
+static serial_rx_ring g_rx_ring_usart1;
+static serial_rx_ring g_rx_ring_usart2;
+
+static serial_rx_ring *serial_rx_ring_of (USART_TypeDef *USARTx) {
+    serial_rx_ring *ring = USARTx == USART1 ? &g_rx_ring_usart1 : &g_rx_ring_usart2;
+    return ring->enabled ? ring : NULL;
+}
+
+// Move the received byte (if any) into the ring. An overrun raises the same
+// interrupt as RXNE, so its flag has to be cleared here or the handler would
+// be entered again straight away.
+static void serial_rx_isr (USART_TypeDef *USARTx, serial_rx_ring *ring) {
+    if (USARTx->ISR & USART_ISR_ORE) ring->dropped++;
+    serial_clear_rx_errors (USARTx);
+    if (USARTx->ISR & USART_ISR_RXNE) {
+	uint8_t byte = USARTx->RDR & 0xFF;
+	uint16_t next = (ring->head + 1) % SERIAL_RX_RING_SIZE;
+	if (next == ring->tail) {
+	    ring->dropped++;
+	    return;
+	}
+	ring->data[ring->head] = byte;
+	ring->head = next;
+    }
+}
+
+extern "C" void USART1_IRQHandler () {
+    serial_rx_isr (USART1, &g_rx_ring_usart1);
+}
+
+extern "C" void USART2_IRQHandler () {
+    serial_rx_isr (USART2, &g_rx_ring_usart2);
+}
+
+// Take a byte from the ring; -1 if it is empty.
+static int serial_rx_ring_pop (serial_rx_ring *ring) {
+    uint16_t tail = ring->tail;
+    if (tail == ring->head) return -1;
+    int c = ring->data[tail];
+    ring->tail = (tail + 1) % SERIAL_RX_RING_SIZE;
+    return c;
+}
+
+// Receive USARTx (USART1 or USART2) through its interrupt from now on, so
+// bytes are kept while the program is busy; serial_read_timeout() and
+// serial_flush_rx() then read the ring. Call after serial_start().
+void serial_rx_interrupt_enable (USART_TypeDef *USARTx) {
+    serial_rx_ring *ring = USARTx == USART1 ? &g_rx_ring_usart1 : &g_rx_ring_usart2;
+    IRQn_Type irq = USARTx == USART1 ? USART1_IRQn : USART2_IRQn;
+
+    ring->head = ring->tail = 0;
+    ring->enabled = true;
+    serial_clear_rx_errors (USARTx);
+    USARTx->CR1 |= USART_CR1_RXNEIE;
+    NVIC_EnableIRQ (irq);
+}
+
+// Bytes USARTx has lost since boot because nobody took them in time (only
+// counted once the receive interrupt is enabled).
+uint32_t serial_rx_dropped (USART_TypeDef *USARTx) {
+    serial_rx_ring *ring = serial_rx_ring_of (USARTx);
+    return ring ? ring->dropped : 0;
+}
+
+// Wait up to roughly timeout_us microseconds for a byte.
+// Returns the byte (0-255), or -1 if nothing arrived in time. Unlike
+// serial_read(), a timeout can be told apart from a received 0x00.
+int serial_read_timeout (USART_TypeDef *USARTx, uint32_t timeout_us) {
+    serial_rx_ring *ring = serial_rx_ring_of (USARTx);
+
+    for (uint32_t us = 0; us <= timeout_us; us++) {
+	if (ring) {
+	    int c = serial_rx_ring_pop (ring);
+	    if (c >= 0) return c;
+	} else {
+	    serial_clear_rx_errors (USARTx);
+	    if (USARTx->ISR & USART_ISR_RXNE)
+		return (int)(USARTx->RDR & 0xFF);
+	}
+	USART_Delay (1);
+    }
+    return -1;
+}
+
+// Throw away anything already sitting in the receiver (stale or late replies).
+// Returns the number of bytes discarded.
+int serial_flush_rx (USART_TypeDef *USARTx) {
+    serial_rx_ring *ring = serial_rx_ring_of (USARTx);
+    int n = 0;
+
+    if (ring) {
+	while (serial_rx_ring_pop (ring) >= 0) n++;
+	return n;
+    }
+    serial_clear_rx_errors (USARTx);
+    while (USARTx->ISR & USART_ISR_RXNE) {
+	(void)USARTx->RDR;
+	n++;
+	serial_clear_rx_errors (USARTx);
+    }
+    return n;
+}
+
+// Change the baud rate of a USART that host_serial_init() already set up.
+// BRR can only be written while the USART is disabled, and must be at least
+// 16 (oversampling by 16), so a rate the clock can't reach is refused.
+EE14Lib_Err serial_set_baud (USART_TypeDef *USARTx, int baud) {
+    extern uint32_t SystemCoreClock;
+
+    if (baud <= 0 || SystemCoreClock / baud < 16)
+	return EE14Lib_ERR_INVALID_CONFIG;
+    while (!(USARTx->ISR & USART_ISR_TC));	// Let any byte in flight finish
+    USARTx->CR1 &= ~USART_CR1_UE;
+    USARTx->BRR  = SystemCoreClock / baud;
+    USARTx->CR1 |= USART_CR1_UE;
+    return EE14Lib_Err_OK;
+}
+
+// Send an unsigned integer in decimal, without pulling in stdio.
+void serial_write_uint (USART_TypeDef *USARTx, uint32_t value) {
+    char out[10];
+    int len = 0;
+    do {
+	out[sizeof(out) - 1 - len++] = '0' + value % 10;
+	value /= 10;
+    } while (value);
+    serial_write (USARTx, &out[sizeof(out) - len], len);
+}
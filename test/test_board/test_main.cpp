@@ -0,0 +1,168 @@
+/* One-pass board init against the per-pin sequence it replaced
+ *
+ *   pio test -e native
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include "board.h"
+
+#define TIMING_RUNS 1000
+
+// The startup sequence from before board.h, kept here as the reference:
+// host_serial_init() (clocks, both CCIPR fields, PA9/PA10 set up twice,
+// each USART started and waited for in turn), then main()'s D9 output and
+// A6 input.
+static void legacy_usart_init(USART_TypeDef *USARTx, int baud) {
+    extern uint32_t SystemCoreClock;
+    USARTx->CR1 &= ~USART_CR1_UE;
+    USARTx->CR1 &= ~USART_CR1_M;
+    USARTx->CR2 &= ~USART_CR2_STOP;
+    USARTx->BRR = SystemCoreClock / baud;
+    USARTx->CR1 &= ~USART_CR1_OVER8;
+    USARTx->CR1 |= USART_CR1_TE;
+    USARTx->CR1 |= USART_CR1_RE;
+    USARTx->CR1 |= USART_CR1_UE;
+    while ((USARTx->ISR & USART_ISR_TEACK) == 0)
+        ;
+    while ((USARTx->ISR & USART_ISR_REACK) == 0)
+        ;
+}
+
+static void legacy_serial_pins(unsigned int tx, unsigned int rx) {
+    set_gpio_alt_func(GPIOA, tx, 7);
+    set_gpio_alt_func(GPIOA, rx, 7);
+    GPIOA->OSPEEDR |= 0x3 << (2 * tx) | 0x3 << (2 * rx);
+    GPIOA->PUPDR &= ~((0x3 << (2 * tx)) | (0x3 << (2 * rx)));
+    GPIOA->PUPDR |= (0x1 << (2 * tx)) | (0x1 << (2 * rx));
+    GPIOA->OTYPER &= ~((0x3 << (2 * tx)) | (0x3 << (2 * rx)));
+}
+
+static void legacy_init() {
+    RCC->APB1ENR1 |= RCC_APB1ENR1_USART2EN;
+    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
+    RCC->CCIPR &= ~RCC_CCIPR_USART2SEL;
+    RCC->CCIPR |= RCC_CCIPR_USART2SEL_0;
+    RCC->CCIPR &= ~RCC_CCIPR_USART1SEL;
+    RCC->CCIPR |= RCC_CCIPR_USART1SEL_0;
+
+    set_gpio_alt_func(GPIOA, 9, 7);
+    set_gpio_alt_func(GPIOA, 10, 7);
+    GPIOA->PUPDR &= ~((0x3 << (2 * 9)) | (0x3 << (2 * 10)));
+    GPIOA->PUPDR |= (0x1 << (2 * 9)) | (0x1 << (2 * 10));
+
+    legacy_serial_pins(2, 3);
+    legacy_serial_pins(9, 10);
+
+    legacy_usart_init(USART2, 9600);
+    legacy_usart_init(USART1, 57600);
+
+    gpio_config_mode(D9, OUTPUT);
+    gpio_config_mode(A6, INPUT);
+}
+
+typedef struct {
+    uint32_t gpio[4][6]; // MODER, OTYPER, OSPEEDR, PUPDR, AFRL, AFRH per port
+    uint32_t ahb2enr, apb1enr1, apb2enr, ccipr;
+    uint32_t usart[2][3]; // CR1, CR2, BRR of USART1 and USART2
+} register_state;
+
+// The registers the two sequences touch, at their reset values (RM0394)
+static void reset_registers() {
+    static const uint32_t moder[4] = {0xABFFFFFF, 0xFFFFFEBF, 0xFFFFFFFF, 0x0000000F};
+    static const uint32_t ospeedr[4] = {0x0C000000, 0, 0, 0};
+    static const uint32_t pupdr[4] = {0x64000000, 0x00000100, 0, 0};
+    GPIO_TypeDef *gpio[4] = {GPIOA, GPIOB, GPIOC, GPIOH};
+
+    for (int p = 0; p < 4; p++) {
+        gpio[p]->MODER = moder[p];
+        gpio[p]->OTYPER = 0;
+        gpio[p]->OSPEEDR = ospeedr[p];
+        gpio[p]->PUPDR = pupdr[p];
+        gpio[p]->AFR[0] = gpio[p]->AFR[1] = 0;
+    }
+    RCC->AHB2ENR = RCC->APB1ENR1 = RCC->APB2ENR = RCC->CCIPR = 0;
+    USART1->CR1 = USART1->CR2 = USART1->BRR = 0;
+    USART2->CR1 = USART2->CR2 = USART2->BRR = 0;
+}
+
+static register_state read_registers() {
+    register_state s;
+    GPIO_TypeDef *gpio[4] = {GPIOA, GPIOB, GPIOC, GPIOH};
+    USART_TypeDef *usart[2] = {USART1, USART2};
+
+    for (int p = 0; p < 4; p++) {
+        s.gpio[p][0] = gpio[p]->MODER;
+        s.gpio[p][1] = gpio[p]->OTYPER;
+        s.gpio[p][2] = gpio[p]->OSPEEDR;
+        s.gpio[p][3] = gpio[p]->PUPDR;
+        s.gpio[p][4] = gpio[p]->AFR[0];
+        s.gpio[p][5] = gpio[p]->AFR[1];
+    }
+    s.ahb2enr = RCC->AHB2ENR;
+    s.apb1enr1 = RCC->APB1ENR1;
+    s.apb2enr = RCC->APB2ENR;
+    s.ccipr = RCC->CCIPR;
+    for (int u = 0; u < 2; u++) {
+        s.usart[u][0] = usart[u]->CR1;
+        s.usart[u][1] = usart[u]->CR2;
+        s.usart[u][2] = usart[u]->BRR;
+    }
+    return s;
+}
+
+// Average cycles (ns on a PC) for one run of init, from reset registers
+static uint32_t time_init(void (*init)()) {
+    uint64_t total = 0;
+    for (int i = 0; i < TIMING_RUNS; i++) {
+        reset_registers();
+        uint32_t start = cycle_counter_read();
+        init();
+        total += cycle_counter_read() - start;
+    }
+    return (uint32_t)(total / TIMING_RUNS);
+}
+
+void setUp() {
+    cycle_counter_init();
+    reset_registers();
+}
+
+void tearDown() {}
+
+// board_init() leaves every register as the old sequence did
+void test_same_registers_as_legacy_sequence() {
+    legacy_init();
+    register_state legacy = read_registers();
+
+    reset_registers();
+    board_init();
+    register_state board = read_registers();
+
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(&legacy.gpio[0][0], &board.gpio[0][0], 4 * 6);
+    TEST_ASSERT_EQUAL_HEX32(legacy.ahb2enr, board.ahb2enr);
+    TEST_ASSERT_EQUAL_HEX32(legacy.apb1enr1, board.apb1enr1);
+    TEST_ASSERT_EQUAL_HEX32(legacy.apb2enr, board.apb2enr);
+    TEST_ASSERT_EQUAL_HEX32(legacy.ccipr, board.ccipr);
+    TEST_ASSERT_EQUAL_HEX32_ARRAY(&legacy.usart[0][0], &board.usart[0][0], 2 * 3);
+}
+
+// Both sequences through the same DWT probe as the boot-time figure. Only
+// reported: on a PC the registers are RAM and the USARTs are up at once, so
+// the figures say little about the board, where this test prints cycles.
+void test_time_against_legacy_sequence() {
+    uint32_t legacy = time_init(legacy_init);
+    uint32_t board = time_init(board_init);
+
+    char line[80];
+    snprintf(line, sizeof(line), "init cycles: legacy %u, board_init %u",
+             (unsigned)legacy, (unsigned)board);
+    TEST_MESSAGE(line);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_same_registers_as_legacy_sequence);
+    RUN_TEST(test_time_against_legacy_sequence);
+    return UNITY_END();
+}
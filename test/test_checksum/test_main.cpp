@@ -0,0 +1,50 @@
+/* Portable checksum code against its references
+ *
+ *   pio test -e native
+ */
+
+#include <unity.h>
+#include "checksum.h"
+
+#define TEST_SEED 0x2545F491
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// Every sum16 variant agrees with the bytewise loop at any alignment and
+// length, including the odd bytes at either end of a word
+void test_sum16_variants_agree() {
+    static uint8_t buf[1024 + 3];
+    uint32_t rng = TEST_SEED;
+
+    for (unsigned i = 0; i < sizeof(buf); i++) {
+        rng ^= rng << 13; // xorshift32
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        buf[i] = (uint8_t)rng;
+    }
+    for (uint32_t off = 0; off < 4; off++) {
+        for (uint32_t len = 0; len <= 1024; len++) {
+            uint16_t ref = checksum_sum16_bytewise(0x1234, buf + off, len);
+            TEST_ASSERT_EQUAL_UINT16(ref, checksum_sum16_swar(0x1234, buf + off, len));
+            TEST_ASSERT_EQUAL_UINT16(ref, checksum_sum16(0x1234, buf + off, len));
+        }
+    }
+}
+
+// The standard check values over "123456789"
+void test_crc_check_values() {
+    const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0x29B1, checksum_crc16_ccitt(check, 9));
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, checksum_crc32(check, 9));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sum16_variants_agree);
+    RUN_TEST(test_crc_check_values);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+/* Config store against the simulated flash (src/host/flash.cpp)
+ *
+ *   pio test -e native
+ */
+
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include "config_store.h"
+#include "host.h"
+
+// A run of writes long enough to compact into each page twice, mixing 32-bit
+// values with the 25-byte enrollment bitmap
+#define WORKLOAD_WRITES 240
+#define WORKLOAD_KEYS 6 // Keys 0-4 take 32-bit values, CONFIG_KEY_ENROLLED a bitmap
+
+typedef struct {
+    uint8_t value[WORKLOAD_KEYS][CONFIG_ENROLLED_BYTES];
+    uint8_t len[WORKLOAD_KEYS]; // 0 if never written
+} store_model;
+
+static void workload_write(int i, uint8_t *key, uint8_t *value, uint8_t *len) {
+    *key = (i * 7) % WORKLOAD_KEYS;
+    if (*key == CONFIG_KEY_ENROLLED) {
+        *len = CONFIG_ENROLLED_BYTES;
+        for (int b = 0; b < *len; b++) value[b] = (uint8_t)(i + b);
+    } else {
+        uint32_t v = 1000 + i;
+        *len = sizeof(v);
+        memcpy(value, &v, sizeof(v));
+    }
+}
+
+static void model_apply(store_model *model, int i) {
+    uint8_t key, value[CONFIG_MAX_VALUE], len;
+    workload_write(i, &key, value, &len);
+    memcpy(model->value[key], value, len);
+    model->len[key] = len;
+}
+
+static void check_store_matches(const store_model *model, const char *what) {
+    for (int k = 0; k < WORKLOAD_KEYS; k++) {
+        uint8_t value[CONFIG_MAX_VALUE];
+        int len = config_get(k, value, sizeof(value));
+        if (!model->len[k]) {
+            TEST_ASSERT_EQUAL_INT_MESSAGE(-1, len, what);
+        } else {
+            TEST_ASSERT_EQUAL_INT_MESSAGE(model->len[k], len, what);
+            TEST_ASSERT_EQUAL_MEMORY_MESSAGE(model->value[k], value, len, what);
+        }
+    }
+}
+
+void setUp() {
+    host_flash_reset();
+}
+
+void tearDown() {}
+
+// Power cut at every erase and double-word program of the workload, both
+// before the operation starts and halfway through it. After the reboot every
+// key must read back as its last committed value (a write counts once
+// config_set() has returned OK), and the store must still take writes.
+void test_power_cut_at_every_flash_operation() {
+    // Count the operations of an uninterrupted run
+    TEST_ASSERT_EQUAL_INT(EE14Lib_Err_OK, config_store_init());
+    uint32_t first_op = host_flash_ops();
+    for (int i = 0; i < WORKLOAD_WRITES; i++) {
+        uint8_t key, value[CONFIG_MAX_VALUE], len;
+        workload_write(i, &key, value, &len);
+        TEST_ASSERT_EQUAL_INT(EE14Lib_Err_OK, config_set(key, value, len));
+    }
+    uint32_t total_ops = host_flash_ops() - first_op;
+    TEST_ASSERT_TRUE(host_flash_erases(CONFIG_STORE_FIRST_PAGE) >= 2);
+    TEST_ASSERT_TRUE(host_flash_erases(CONFIG_STORE_FIRST_PAGE + 1) >= 2);
+
+    for (uint32_t cut = 0; cut < total_ops; cut++) {
+        for (int how = HOST_FLASH_CUT_BEFORE; how <= HOST_FLASH_CUT_PARTIAL; how++) {
+            char what[48];
+            snprintf(what, sizeof(what), "cut at op %u, %s", (unsigned)cut,
+                     how == HOST_FLASH_CUT_BEFORE ? "before" : "partial");
+
+            host_flash_reset();
+            config_store_init();
+            host_flash_cut_power(cut, how);
+            store_model model = {};
+            for (int i = 0; i < WORKLOAD_WRITES; i++) {
+                uint8_t key, value[CONFIG_MAX_VALUE], len;
+                workload_write(i, &key, value, &len);
+                if (config_set(key, value, len) != EE14Lib_Err_OK) break;
+                model_apply(&model, i);
+            }
+            TEST_ASSERT_FALSE_MESSAGE(host_flash_powered(), what);
+
+            // Reboot
+            host_flash_power_on();
+            TEST_ASSERT_EQUAL_INT_MESSAGE(EE14Lib_Err_OK, config_store_init(), what);
+            check_store_matches(&model, what);
+
+            // The torn record must not get in the way of the next write
+            uint32_t sentinel = 0xC0FFEE00 + cut;
+            TEST_ASSERT_EQUAL_INT_MESSAGE(EE14Lib_Err_OK, config_set_u32(1, sentinel), what);
+            memcpy(model.value[1], &sentinel, sizeof(sentinel));
+            model.len[1] = sizeof(sentinel);
+            config_store_init();
+            check_store_matches(&model, what);
+        }
+    }
+}
+
+// Wear over many writes: compaction alternates between the two pages, so
+// they erase evenly, about once per page-full of records.
+void test_erases_per_page() {
+    const uint32_t writes = 100000;
+    config_store_init();
+    for (uint32_t i = 0; i < writes; i++)
+        TEST_ASSERT_EQUAL_INT(EE14Lib_Err_OK, config_set_u32(1 + i % 4, i));
+
+    uint32_t erases0 = host_flash_erases(CONFIG_STORE_FIRST_PAGE);
+    uint32_t erases1 = host_flash_erases(CONFIG_STORE_FIRST_PAGE + 1);
+    TEST_ASSERT_UINT32_WITHIN(1, erases0, erases1);
+
+    // A 32-bit record is 24 bytes; the page header and the four live keys
+    // copied forward by each compaction take the rest of the room
+    const uint32_t per_page = (FLASH_PAGE_SIZE - 8) / 24 - 4;
+    TEST_ASSERT_UINT32_WITHIN(2, writes / per_page, erases0 + erases1);
+
+    char line[96];
+    snprintf(line, sizeof(line), "%u writes: page %d erased %u times, page %d %u times",
+             (unsigned)writes, CONFIG_STORE_FIRST_PAGE, (unsigned)erases0,
+             CONFIG_STORE_FIRST_PAGE + 1, (unsigned)erases1);
+    TEST_MESSAGE(line);
+}
+
+// Rewriting the value a key already holds costs no flash at all
+void test_same_value_is_not_rewritten() {
+    config_store_init();
+    TEST_ASSERT_EQUAL_INT(EE14Lib_Err_OK, config_set_u32(CONFIG_KEY_DUTY_OPEN, 77));
+    uint32_t ops = host_flash_ops();
+    TEST_ASSERT_EQUAL_INT(EE14Lib_Err_OK, config_set_u32(CONFIG_KEY_DUTY_OPEN, 77));
+    TEST_ASSERT_EQUAL_UINT32(ops, host_flash_ops());
+    TEST_ASSERT_EQUAL_UINT32(77, config_get_u32(CONFIG_KEY_DUTY_OPEN, 0));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_power_cut_at_every_flash_operation);
+    RUN_TEST(test_erases_per_page);
+    RUN_TEST(test_same_value_is_not_rewritten);
+    return UNITY_END();
+}
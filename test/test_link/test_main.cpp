@@ -0,0 +1,131 @@
+/* Link layer against the simulated sensor on a clean and a noisy line
+ *
+ *   pio test -e native
+ */
+
+#include <unity.h>
+#include "fingerprint.h"
+#include "sensor_sim.h"
+
+#define TEST_PAGE 42
+#define TEST_SEED 0x2545F491
+
+void setUp() {
+    sensor_sim_begin(&SENSOR_SIM_ZFM20_TIMING);
+    sensor_sim_enroll(TEST_PAGE);
+    sensor_sim_place_finger(TEST_PAGE);
+    fingerprint_recent_configure(FINGERPRINT_RECENT_SIZE);
+    g_fingerprint_stats = fingerprint_link_stats();
+    g_fingerprint_match_stats = fingerprint_match_stats();
+}
+
+void tearDown() {
+    sensor_sim_end();
+}
+
+// Nothing to recover from on a clean line
+void test_clean_line_needs_no_recovery() {
+    for (int i = 0; i < 50; i++) {
+        uint16_t page_id = 0;
+        TEST_ASSERT_TRUE(fingerprint_match(&page_id));
+        TEST_ASSERT_EQUAL_UINT16(TEST_PAGE, page_id);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, g_fingerprint_stats.checksum_failures);
+    TEST_ASSERT_EQUAL_UINT32(0, g_fingerprint_stats.resyncs);
+    TEST_ASSERT_EQUAL_UINT32(0, g_fingerprint_stats.timeouts);
+    TEST_ASSERT_EQUAL_UINT32(0, g_fingerprint_stats.retries);
+    TEST_ASSERT_EQUAL_UINT32(0, g_fingerprint_stats.recoveries);
+}
+
+// A regular is found by the one-page probe once the list knows them, and a
+// finger that isn't enrolled doesn't end up in the list
+void test_regular_takes_the_fast_path() {
+    uint16_t page_id = 0;
+
+    sensor_sim_place_finger(SENSOR_SIM_UNKNOWN_FINGER);
+    TEST_ASSERT_FALSE(fingerprint_match(&page_id));
+    sensor_sim_place_finger(TEST_PAGE);
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(fingerprint_match(&page_id));
+        TEST_ASSERT_EQUAL_UINT16(TEST_PAGE, page_id);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, g_fingerprint_match_stats.full_matches);
+    TEST_ASSERT_EQUAL_UINT32(19, g_fingerprint_match_stats.fast_hits);
+    TEST_ASSERT_EQUAL_UINT32(0, g_fingerprint_match_stats.fast_misses);
+    TEST_ASSERT_LESS_THAN_UINT32(g_fingerprint_match_stats.miss_us / 2,
+                                 g_fingerprint_match_stats.hit_us / 19);
+}
+
+// A reply that arrives while the firmware is busy elsewhere overruns the
+// bare receive register after its first byte and has to be asked for again;
+// the receive ring keeps all of it
+void test_busy_reader_needs_the_ring() {
+    fingerprint_packet reply;
+
+    sensor_sim_rx_depth(1);
+    fingerprint_command_start(FINGERPRINT_GETIMAGE, NULL, 0);
+    sensor_sim_idle(1000000);
+    TEST_ASSERT_EQUAL_INT(FINGERPRINT_OK, fingerprint_command_finish(FINGERPRINT_GETIMAGE, NULL, 0, &reply));
+    TEST_ASSERT_EQUAL_UINT32(11, sensor_sim_rx_dropped());
+    TEST_ASSERT_EQUAL_UINT32(1, g_fingerprint_stats.retries);
+
+    sensor_sim_rx_depth(SERIAL_RX_RING_SIZE - 1);
+    fingerprint_command_start(FINGERPRINT_GETIMAGE, NULL, 0);
+    sensor_sim_idle(1000000);
+    TEST_ASSERT_EQUAL_INT(FINGERPRINT_OK, fingerprint_command_finish(FINGERPRINT_GETIMAGE, NULL, 0, &reply));
+    TEST_ASSERT_EQUAL_UINT32(11, sensor_sim_rx_dropped());
+    TEST_ASSERT_EQUAL_UINT32(1, g_fingerprint_stats.retries);
+}
+
+// At a bit error rate of 1e-3 about one packet in six is hit. Every kind
+// of recovery has to happen, and it has to work: nearly every scan still
+// ends in the right decision and none in a wrong one.
+void test_noisy_line_recovers() {
+    const int scans = 200;
+    int right = 0;
+
+    sensor_sim_noise(1000, TEST_SEED);
+    for (int i = 0; i < scans; i++) {
+        uint16_t page_id = 0;
+        if (fingerprint_match(&page_id)) {
+            TEST_ASSERT_EQUAL_UINT16(TEST_PAGE, page_id);
+            right++;
+        }
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32(0, g_fingerprint_stats.checksum_failures);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, g_fingerprint_stats.resyncs);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, g_fingerprint_stats.timeouts);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, g_fingerprint_stats.retries);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, g_fingerprint_stats.recoveries);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, g_fingerprint_stats.recovery_us);
+    TEST_ASSERT_GREATER_OR_EQUAL(scans * 95 / 100, right);
+}
+
+// SEARCH takes BufferID, StartPage and PageNum; the old four-byte form is a
+// malformed packet to the sensor, which every retry sends again
+void test_search_needs_five_arguments() {
+    fingerprint_packet reply;
+    uint8_t image2tz[1] = {CHARBUFFER1};
+    uint8_t old_form[4] = {CHARBUFFER1, 0x00, 0x00, FINGERPRINT_LIBRARY_PAGES};
+    uint8_t search[5] = {CHARBUFFER1, 0x00, 0x00, 0x00, FINGERPRINT_LIBRARY_PAGES};
+
+    TEST_ASSERT_EQUAL_INT(FINGERPRINT_OK, fingerprint_command(FINGERPRINT_GETIMAGE, NULL, 0, &reply));
+    TEST_ASSERT_EQUAL_INT(FINGERPRINT_OK, fingerprint_command(FINGERPRINT_IMAGE2TZ, image2tz, 1, &reply));
+
+    TEST_ASSERT_EQUAL_INT(FINGERPRINT_PACKETRECIEVEERR,
+                          fingerprint_command(FINGERPRINT_SEARCH, old_form, 4, &reply));
+    TEST_ASSERT_EQUAL_UINT32(FINGERPRINT_MAX_RETRIES, g_fingerprint_stats.retries);
+
+    TEST_ASSERT_EQUAL_INT(FINGERPRINT_OK, fingerprint_command(FINGERPRINT_SEARCH, search, 5, &reply));
+    TEST_ASSERT_EQUAL_UINT16(TEST_PAGE, (reply.data[1] << 8) | reply.data[2]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_line_needs_no_recovery);
+    RUN_TEST(test_regular_takes_the_fast_path);
+    RUN_TEST(test_noisy_line_recovers);
+    RUN_TEST(test_search_needs_five_arguments);
+    RUN_TEST(test_busy_reader_needs_the_ring);
+    return UNITY_END();
+}
@@ -0,0 +1,62 @@
+// Generated by scripts/trace_to_header.py from monitor.log
+#include <stdint.h>
+
+static const uint8_t g_replay_trace[909] = {
+    0x00, 0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02,
+    0xFF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x03, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00,
+    0xDC, 0x02, 0x05, 0x99, 0xAD, 0x12, 0xEF, 0xDD, 0x02, 0x01, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF,
+    0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x03, 0xDD,
+    0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x0A, 0x00, 0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF,
+    0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC,
+    0x02, 0x04, 0xDC, 0x02, 0x02, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x08, 0xB9, 0x9C,
+    0x22, 0xEF, 0xDD, 0x02, 0x01, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02,
+    0xFF, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x03, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00,
+    0xDD, 0x02, 0x0A, 0x00, 0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02,
+    0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x08, 0xDC, 0x02, 0x04,
+    0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0xC8, 0xDC,
+    0x02, 0x00, 0xDC, 0x02, 0xD6, 0xA9, 0xA2, 0x06, 0xEF, 0xDD, 0x02, 0x01, 0xDD, 0x02, 0xFF, 0xDD,
+    0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02,
+    0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x2A, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x64,
+    0xDD, 0x02, 0x00, 0xDD, 0x02, 0x9C, 0x00, 0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02,
+    0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x03,
+    0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x05, 0x99, 0xAD, 0x12, 0xEF, 0xDD, 0x02, 0x01,
+    0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0x07, 0xDD,
+    0x02, 0x00, 0xDD, 0x02, 0x03, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x0A, 0x00, 0xEF,
+    0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC,
+    0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x04, 0xDC, 0x02, 0x02, 0xDC, 0x02, 0x01, 0xDC, 0x02,
+    0x00, 0xDC, 0x02, 0x08, 0xB9, 0x9C, 0x22, 0xEF, 0xDD, 0x02, 0x01, 0xDD, 0x02, 0xFF, 0xDD, 0x02,
+    0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x03,
+    0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x0A, 0x00, 0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02,
+    0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00,
+    0xDC, 0x02, 0x08, 0xDC, 0x02, 0x04, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x2A, 0xDC,
+    0x02, 0x00, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x39, 0x89, 0x92, 0x01, 0xEF, 0xDD,
+    0x02, 0x01, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02,
+    0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x2A,
+    0xDD, 0x02, 0x00, 0xDD, 0x02, 0x64, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x9C, 0x00, 0xEF, 0xDC, 0x02,
+    0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0x01,
+    0xDC, 0x02, 0x00, 0xDC, 0x02, 0x03, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x05, 0x99,
+    0xAD, 0x12, 0xEF, 0xDD, 0x02, 0x01, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD,
+    0x02, 0xFF, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x03, 0xDD, 0x02, 0x00, 0xDD, 0x02,
+    0x00, 0xDD, 0x02, 0x0A, 0x00, 0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC,
+    0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x04, 0xDC, 0x02,
+    0x02, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x08, 0xB9, 0x9C, 0x22, 0xEF, 0xDD, 0x02,
+    0x01, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0x07,
+    0xDD, 0x02, 0x00, 0xDD, 0x02, 0x03, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x0A, 0x00,
+    0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF,
+    0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x08, 0xDC, 0x02, 0x04, 0xDC, 0x02, 0x01, 0xDC,
+    0x02, 0x00, 0xDC, 0x02, 0x2A, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02,
+    0x39, 0x89, 0x92, 0x01, 0xEF, 0xDD, 0x02, 0x01, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02,
+    0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x09,
+    0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD,
+    0x02, 0x17, 0x00, 0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF,
+    0xDC, 0x02, 0xFF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x08, 0xDC, 0x02, 0x04, 0xDC,
+    0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0xC8, 0xDC, 0x02,
+    0x00, 0xDC, 0x02, 0xD6, 0xB9, 0xB7, 0x19, 0xEF, 0xDD, 0x02, 0x01, 0xDD, 0x02, 0xFF, 0xDD, 0x02,
+    0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0x07, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x07,
+    0xDD, 0x02, 0x09, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x00, 0xDD,
+    0x02, 0x00, 0xDD, 0x02, 0x17, 0x00, 0xEF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF,
+    0xDC, 0x02, 0xFF, 0xDC, 0x02, 0xFF, 0xDC, 0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x03, 0xDC,
+    0x02, 0x01, 0xDC, 0x02, 0x00, 0xDC, 0x02, 0x05, 0x99, 0xAD, 0x12, 0xEF, 0xDD, 0x02, 0x01, 0xDD,
+    0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0xFF, 0xDD, 0x02, 0x07, 0xDD, 0x02,
+    0x00, 0xDD, 0x02, 0x03, 0xDD, 0x02, 0x02, 0xDD, 0x02, 0x00, 0xDD, 0x02, 0x0C,
+};
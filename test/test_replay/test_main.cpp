@@ -0,0 +1,61 @@
+/* Replaying a captured trace through the link layer
+ *
+ * replay_trace.h is scripts/trace_to_header.py's output for monitor.log, a
+ * capture (FINGERPRINT_TRACE) of the link layer talking to the simulated
+ * sensor, in simulated time: page 42 enrolled, its finger matched twice (a
+ * full search, then the one-page probe of the recently-matched list), a
+ * stranger's finger, then an empty glass.
+ *
+ *   pio test -e replay_native
+ */
+
+#include <unity.h>
+#include "fingerprint.h"
+#include "trace.h"
+#include "replay_trace.h"
+
+#define TEST_PAGE 42
+
+void setUp() {
+    cycle_counter_init();
+    fingerprint_recent_configure(FINGERPRINT_RECENT_SIZE);
+    g_fingerprint_match_stats = fingerprint_match_stats();
+    trace_replay_begin(g_replay_trace, sizeof(g_replay_trace));
+}
+
+void tearDown() {
+}
+
+// The same firmware sends exactly the captured commands and comes to the
+// same decisions from the captured replies
+void test_replay_repeats_the_decisions() {
+    uint16_t page_id = 0;
+
+    TEST_ASSERT_TRUE(fingerprint_match(&page_id));
+    TEST_ASSERT_EQUAL_UINT16(TEST_PAGE, page_id);
+    TEST_ASSERT_TRUE(fingerprint_match(&page_id));
+    TEST_ASSERT_EQUAL_UINT16(TEST_PAGE, page_id);
+    TEST_ASSERT_FALSE(fingerprint_match(&page_id));
+    TEST_ASSERT_FALSE(fingerprint_match(&page_id));
+
+    TEST_ASSERT_EQUAL_UINT32(1, g_fingerprint_match_stats.full_matches);
+    TEST_ASSERT_EQUAL_UINT32(1, g_fingerprint_match_stats.fast_hits);
+    TEST_ASSERT_TRUE(trace_replay_done());
+    TEST_ASSERT_EQUAL_UINT32(0, trace_replay_mismatches());
+}
+
+// Firmware that sends a different command than the capture shows up as
+// mismatches instead of silently reading replies meant for something else
+void test_different_command_is_a_mismatch() {
+    uint8_t args[1] = {CHARBUFFER1};
+
+    fingerprint_command_start(FINGERPRINT_IMAGE2TZ, args, 1); // Trace starts with GETIMAGE
+    TEST_ASSERT_GREATER_THAN_UINT32(0, trace_replay_mismatches());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_replay_repeats_the_decisions);
+    RUN_TEST(test_different_command_is_a_mismatch);
+    return UNITY_END();
+}
@@ -0,0 +1,96 @@
+/* Software timers, ticked by hand (host_tim16_tick() in src/host/periph.cpp)
+ *
+ *   pio test -e native
+ */
+
+#include <unity.h>
+#include "swtimer.h"
+#include "host.h"
+
+#define TEST_FIRINGS 8
+
+static uint32_t g_fired_at[TEST_FIRINGS];
+static int g_fired;
+
+static void record_firing(void *arg) {
+    (void)arg;
+    if (g_fired < TEST_FIRINGS) g_fired_at[g_fired] = swtimer_now_ms();
+    g_fired++;
+}
+
+static void tick(int ticks) {
+    while (ticks--) host_tim16_tick();
+}
+
+void setUp() {
+    swtimer_init();
+    g_fired = 0;
+}
+
+void tearDown() {}
+
+// A one-shot runs on the tick it is due, once, and not a tick before
+void test_one_shot_fires_on_its_tick() {
+    static swtimer t;
+    uint32_t start = swtimer_now_ms();
+
+    swtimer_arm(&t, 5, 0, record_firing, NULL);
+    tick(4);
+    TEST_ASSERT_EQUAL_INT(0, g_fired);
+    TEST_ASSERT_TRUE(swtimer_armed(&t));
+    tick(1);
+    TEST_ASSERT_EQUAL_INT(1, g_fired);
+    TEST_ASSERT_EQUAL_UINT32(start + 5, g_fired_at[0]);
+    TEST_ASSERT_FALSE(swtimer_armed(&t));
+    tick(SWTIMER_WHEEL_SLOTS * 2);
+    TEST_ASSERT_EQUAL_INT(1, g_fired);
+}
+
+// Further out than the wheel: the timer laps its slot until it is due
+void test_long_timer_waits_its_laps() {
+    static swtimer t;
+    uint32_t start = swtimer_now_ms();
+    uint32_t delay = SWTIMER_WHEEL_SLOTS * 3 + 7;
+
+    swtimer_arm(&t, delay, 0, record_firing, NULL);
+    tick(delay - 1);
+    TEST_ASSERT_EQUAL_INT(0, g_fired);
+    tick(1);
+    TEST_ASSERT_EQUAL_INT(1, g_fired);
+    TEST_ASSERT_EQUAL_UINT32(start + delay, g_fired_at[0]);
+}
+
+// A periodic timer fires every period on the dot, without drifting
+void test_periodic_does_not_drift() {
+    static swtimer t;
+    uint32_t start = swtimer_now_ms();
+
+    swtimer_arm(&t, 3, 10, record_firing, NULL);
+    tick(3 + 10 * (TEST_FIRINGS - 1));
+    TEST_ASSERT_EQUAL_INT(TEST_FIRINGS, g_fired);
+    for (int i = 0; i < TEST_FIRINGS; i++)
+        TEST_ASSERT_EQUAL_UINT32(start + 3 + 10 * i, g_fired_at[i]);
+    swtimer_cancel(&t);
+}
+
+// A cancelled timer never fires, and cancelling twice is harmless
+void test_cancel() {
+    static swtimer t;
+
+    swtimer_arm(&t, 2, 0, record_firing, NULL);
+    tick(1);
+    swtimer_cancel(&t);
+    swtimer_cancel(&t);
+    TEST_ASSERT_FALSE(swtimer_armed(&t));
+    tick(SWTIMER_WHEEL_SLOTS);
+    TEST_ASSERT_EQUAL_INT(0, g_fired);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_one_shot_fires_on_its_tick);
+    RUN_TEST(test_long_timer_waits_its_laps);
+    RUN_TEST(test_periodic_does_not_drift);
+    RUN_TEST(test_cancel);
+    return UNITY_END();
+}